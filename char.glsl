@@ -0,0 +1,85 @@
+/* Quad instance layouts and glyph bounds, shared by text.vert and cull.comp */
+
+#define GLYPHS ((FONT_WIDTH / CHAR_WIDTH) * (FONT_WIDTH / CHAR_WIDTH))
+
+#ifdef PACKED
+struct Char {
+	vec3 pos;
+	uint scale_value; // Half scale, u8 value
+	uvec2 rot;        // Half quaternion
+	uint col;         // Unorm
+	uint fx;          // Half
+};
+#elif defined(DIRECT) // struct txt_quad
+struct Char {
+	mat4 model;
+	vec4 col;
+	vec2 fx;
+	uint value; // Low byte only
+};
+#else
+struct Char {
+	mat4 model;
+	vec4 col;
+	vec2 off;
+	vec2 fx;
+};
+#endif
+
+#ifdef PACKED
+mat4 trs(vec3 pos, vec4 q, float s)
+{
+	vec3 q2 = 2 * q.xyz;
+	float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+	float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+	float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+
+	return mat4(
+		  vec4(s * vec3(1 - yy - zz, xy + wz, xz - wy), 0)
+		, vec4(s * vec3(xy - wz, 1 - xx - zz, yz + wx), 0)
+		, vec4(s * vec3(xz + wy, yz - wx, 1 - xx - yy), 0)
+		, vec4(pos, 1)
+	);
+}
+
+mat4 char_model(Char c)
+{
+	vec4 rot = vec4(unpackHalf2x16(c.rot.x), unpackHalf2x16(c.rot.y));
+	float scale = unpackHalf2x16(c.scale_value).x;
+	return trs(c.pos, normalize(rot), scale);
+}
+#else
+mat4 char_model(Char c)
+{
+	return c.model;
+}
+#endif
+
+uint char_value(Char c)
+{
+#ifdef PACKED
+	return (c.scale_value >> 16) & 0xFF;
+#elif defined(DIRECT)
+	return c.value & 0xFF;
+#else
+	return uint(c.off.x) + uint(c.off.y) * (FONT_WIDTH / CHAR_WIDTH);
+#endif
+}
+
+layout (set = 0, binding = 2) uniform Metrics {
+	vec4 box[GLYPHS]; // struct glyph
+} metrics;
+
+bool glyph_empty(uint value)
+{
+	return metrics.box[value].xy == metrics.box[value].zw;
+}
+
+// Corner t (0 or 1 per axis) of the padded glyph bounds,
+// in cell units with y down; empty glyphs collapse to a point
+vec2 glyph_corner(uint value, vec2 t)
+{
+	vec4 box = metrics.box[value];
+	if (box.xy == box.zw) return vec2(0);
+	return mix(box.xy - PADDING, box.zw + PADDING, t);
+}
@@ -1,11 +1,28 @@
 #define GPU_IDX 0
 #define SWAP_IMG_COUNT 3
+#define FRAMES_IN_FLIGHT 2
+#define MAX_FRAMES_IN_FLIGHT 4
+#define HEADLESS_W 1280 // Default offscreen extent
+#define HEADLESS_H 720
 #define MAX_DT (1.f / 10.f)
+#define STATS_FRAMES 1024 // Per-frame samples kept for percentiles
+#define SCALE_STEPS 4 // Render scales from 1 down to SCALE_MIN (dynamic res)
+#define SCALE_MIN .5f
+#define SCALE_EMA .1f // Frame time smoothing
+#define SCALE_HEADROOM .8f // Of the budget, needed to step back up
+#define SCALE_HOLD 30 // Frames between steps
 
-#define MAX_QUAD (8192 * 16)
+#define QUAD_CAP 8192 // Initial; the txt_buf grows on demand
+#define MAX_WORKERS 15
+#define PARALLEL_MIN_QUAD 16384 // Convert smaller batches on one thread
+#define TEXT_QUEUE 64 // Text events per frame, for threaded update
+#define CULL_GROUP 64 // Workgroup size of the culling pre-pass
 
 #define FONT_WIDTH 128
 #define CHAR_WIDTH 8
+#define MIP_BIAS 0.f // Font LOD bias; negative keeps minified text sharper
+#define SDF_SCALE 4 // Distance field texels per font texel
+#define SDF_SPREAD 1.f // Distance encoded at the extremes, in font texels
 
 #define PADDING (1.f / CHAR_WIDTH)
 #define BIAS 0.001f
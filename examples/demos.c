@@ -193,7 +193,8 @@ struct txt_share txtquad_update(struct txt_frame frame, struct txt_buf *txt)
 		);
 	}
 #elif DEMO_5
-	const size_t waterline = MAX_QUAD;
+	const size_t waterline = 8192 * 16;
+	txtquad_reserve(txt, waterline);
 	txt->count = waterline;
 
 	const fff origin = V3_FWD;
@@ -225,9 +226,20 @@ struct txt_share txtquad_update(struct txt_frame frame, struct txt_buf *txt)
 		};
 	}
 
-	if (frame.i > 32 && frame.t > 3.f && frame.dt > 1.f / 60.f + 1e-3) {
-		fprintf(stderr, "dt=%f (%.1f)\n", frame.dt, 1.f / frame.dt);
-		panic_msg("performance barrier reached");
+	// Report the frame time distribution whenever it is refreshed
+	static size_t reported;
+	if (frame.stats.n && (size_t)frame.t != reported) {
+		struct txt_dist dt = frame.stats.dt;
+		printf(
+			"dt (ms): p50=%.2f p95=%.2f p99=%.2f max=%.2f (%zu frames)\n",
+			dt.p50 * 1000.f,
+			dt.p95 * 1000.f,
+			dt.p99 * 1000.f,
+			dt.max * 1000.f,
+			frame.stats.n
+		);
+
+		reported = frame.t;
 	}
 #endif
 	float asp = (float)frame.size.w / frame.size.h;
@@ -262,6 +274,9 @@ int main()
 		.mode = MODE_BORDERLESS,
 		.cursor = CURSOR_SCREEN,
 	};
+#ifdef DEMO_5
+	cfg.stats_csv = "./frames.csv";
+#endif
 
 	txtquad_init(cfg);
 	txtquad_start();
@@ -94,7 +94,7 @@ static void draw_marker(
 	};
 
 	size_t char_count = txt->count++;
-	assert(char_count < MAX_QUAD);
+	txtquad_reserve(txt, char_count + 1);
 	txt->quads[char_count] = sprite_conv(result);
 }
 #endif
@@ -38,7 +38,7 @@ static void profile_log(struct txt_buf *txt)
 		const float pc = 100.f
 			* count / (float)txt->count;
 		const float pressure = 100.f
-			* count / (float)MAX_QUAD;
+			* count / (float)txt->cap;
 
 		printf(
 			"%2u.%16s%16u%16.2f%%%16.2f%%\n",
@@ -51,7 +51,7 @@ static void profile_log(struct txt_buf *txt)
 	}
 
 	const float pressure = 100.f
-		* quad_profile.total / (float)MAX_QUAD;
+		* quad_profile.total / (float)txt->cap;
 	printf(
 		"   %16s%16u%16.2f%%%16.2f%%\n",
 		"",
@@ -69,13 +69,13 @@ static struct txt_quad sprite_conv(struct sprite in)
 static void quad_draw_imm(struct txt_quad quad, struct txt_buf *txt)
 {
 	size_t count = txt->count++;
-	assert(count < MAX_QUAD);
+	txtquad_reserve(txt, count + 1);
 	*(txt->quads + count) = quad;
 }
 
 static void sprite_draw_imm(struct sprite in, struct txt_buf *txt)
 {
 	size_t count = txt->count++;
-	assert(count < MAX_QUAD);
+	txtquad_reserve(txt, count + 1);
 	*(txt->quads + count) = sprite_conv(in);
 }
@@ -1,22 +1,22 @@
 #ifdef INP_KEYS
 #include "inp.h"
 
-void inp_update(GLFWwindow *win)
+void inp_update(GLFWwindow *win, struct Input *inp)
 {
-	for (size_t i = 0; i < inp_data.key.count; ++i) {
-		int handle = inp_data.key.handles[i];
-		char s = inp_data.key.states[handle];
+	for (size_t i = 0; i < inp->key.count; ++i) {
+		int handle = inp->key.handles[i];
+		char s = inp->key.states[handle];
 		s = (s << 1) & 2;
 		s |= glfwGetKey(win, handle) == GLFW_PRESS;
-		inp_data.key.states[handle] = s;
+		inp->key.states[handle] = s;
 	}
 
-	for (size_t i = 0; i < inp_data.btn.count; ++i) {
-		int handle = inp_data.btn.handles[i];
-		char s = inp_data.btn.states[handle];
+	for (size_t i = 0; i < inp->btn.count; ++i) {
+		int handle = inp->btn.handles[i];
+		char s = inp->btn.states[handle];
 		s = (s << 1) & 2;
 		s |= glfwGetMouseButton(win, handle) == GLFW_PRESS;
-		inp_data.btn.states[handle] = s;
+		inp->btn.states[handle] = s;
 	}
 
 	/* Mouse */
@@ -25,15 +25,15 @@ void inp_update(GLFWwindow *win)
 	glfwGetCursorPos(win, &mx, &my);
 
 	v2 pos = { mx, my * -1.f };
-	inp_data.mouse.pos = pos;
+	inp->mouse.pos = pos;
 
 	static v2 mouse_last;
 	static float dirty;
 
-	mouse_last = v2_lerp(inp_data.mouse.pos, mouse_last, dirty);
+	mouse_last = v2_lerp(inp->mouse.pos, mouse_last, dirty);
 	dirty = 1.f;
 
-	inp_data.mouse.delta = v2_sub(pos, mouse_last);
+	inp->mouse.delta = v2_sub(pos, mouse_last);
 	mouse_last = pos;
 
 	/* Joy */
@@ -43,27 +43,27 @@ void inp_update(GLFWwindow *win)
 	GLFWgamepadstate pad;
 	if (!glfwGetGamepadState(GLFW_JOYSTICK_1, &pad)) return;
 
-	for (size_t i = 0; i < inp_data.pad.count; ++i) {
-		int handle = inp_data.pad.handles[i];
-		char s = inp_data.pad.states[handle];
+	for (size_t i = 0; i < inp->pad.count; ++i) {
+		int handle = inp->pad.handles[i];
+		char s = inp->pad.states[handle];
 		s = (s << 1) & 2;
 		s |= pad.buttons[handle] == GLFW_PRESS;
-		inp_data.pad.states[handle] = s;
+		inp->pad.states[handle] = s;
 	}
 
-	inp_data.joy.stick_l = (v2) {
+	inp->joy.stick_l = (v2) {
 		 pad.axes[GLFW_GAMEPAD_AXIS_LEFT_X],
 		-pad.axes[GLFW_GAMEPAD_AXIS_LEFT_Y],
 	};
 
-	inp_data.joy.stick_r = (v2) {
+	inp->joy.stick_r = (v2) {
 		 pad.axes[GLFW_GAMEPAD_AXIS_RIGHT_X],
 		-pad.axes[GLFW_GAMEPAD_AXIS_RIGHT_Y],
 	};
 
-	inp_data.joy.trigg_l = .5f + .5f
+	inp->joy.trigg_l = .5f + .5f
 		* pad.axes[GLFW_GAMEPAD_AXIS_LEFT_TRIGGER];
-	inp_data.joy.trigg_r = .5f + .5f
+	inp->joy.trigg_r = .5f + .5f
 		* pad.axes[GLFW_GAMEPAD_AXIS_RIGHT_TRIGGER];
 }
 
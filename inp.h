@@ -73,6 +73,6 @@ extern struct Input {
 } inp_data;
 #undef INP_DATA_STRUCT
 
-void inp_update(GLFWwindow *win);
+void inp_update(GLFWwindow *win, struct Input*);
 
 #endif
@@ -3,6 +3,7 @@
 #endif
 
 #include <string.h>
+#include <stddef.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <assert.h>
@@ -29,10 +30,75 @@
 #define PLATFORM_COMPAT_VBO
 #endif
 
-static struct txt_buf txt;
+#if !defined _WIN32
+#define PLATFORM_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#endif
+
+#if defined _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Runtime dispatch relies on __builtin_cpu_supports()
+#if (defined __x86_64__ || defined __i386__) && !defined _WIN32
+#define PLATFORM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static struct txt_buf *txt; // Unused in threaded mode
 static char *root_path;
 static char *filename;
 
+/* Monotonic clock */
+
+static u64 now_ns()
+{
+#if defined _WIN32
+	static LARGE_INTEGER freq;
+	if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (u64)(t.QuadPart / freq.QuadPart) * 1000000000ull
+		+ (u64)(t.QuadPart % freq.QuadPart) * 1000000000ull
+		/ freq.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (u64)t.tv_sec * 1000000000ull + t.tv_nsec;
+#endif
+}
+
+static void sleep_ns(u64 ns)
+{
+#if defined _WIN32
+	Sleep(ns / 1000000); // Millisecond granularity
+#else
+	struct timespec t = {
+		.tv_sec = ns / 1000000000ull,
+		.tv_nsec = ns % 1000000000ull,
+	};
+
+	while (nanosleep(&t, &t) && errno == EINTR);
+#endif
+}
+
+// Sleeps until the next frame is due; never tries to catch up
+static void pace(u64 *next, u64 period)
+{
+	u64 now = now_ns();
+	if (now < *next) {
+		sleep_ns(*next - now);
+		*next += period;
+	} else *next = now + period;
+}
+
 struct raw_char {
 	m4 trs;
 	v4 col;
@@ -48,21 +114,554 @@ static ALG_INLINE v2 char_off(u8 c)
 	};
 }
 
-static void txt_update(struct raw_char *buf)
-{
-	for (size_t i = 0; i < txt.count; ++i) {
-		struct txt_quad *quad = txt.quads + i;
-		buf[i] = (struct raw_char) {
+_Static_assert(
+	sizeof(struct txt_quad) == 96,
+	"quad must match the direct layout in char.glsl"
+);
+
+_Static_assert(
+	sizeof(struct raw_char) == 96
+	&& offsetof(struct txt_quad, _extra) == 80,
+	"conversion kernels assume 96-byte quads"
+);
+
+typedef void (*conv_fn)(
+	struct raw_char *dst,
+	const struct txt_quad *src,
+	size_t n
+);
+
+static struct conv {
+	conv_fn fn;
+	const char *name;
+} conv;
+
+static void conv_scalar(
+	struct raw_char *dst,
+	const struct txt_quad *src,
+	size_t n
+) {
+	for (size_t i = 0; i < n; ++i) {
+		const struct txt_quad *quad = src + i;
+		dst[i] = (struct raw_char) {
 			  .trs = quad->model,
 			  .col = quad->color,
 			  .off = char_off(quad->value),
 			._slop = quad->_extra,
 		};
 	}
+}
+
+#ifdef PLATFORM_SIMD_X86
+/* The destination is (likely) write-combined:
+ * stream each quad out in whole 16/32-byte chunks,
+ * so that consecutive quads fill entire cache lines
+ * without ever reading the destination back.
+ */
+
+__attribute__((target("sse2")))
+static ALG_INLINE __m128 conv_tail(const struct txt_quad *quad)
+{
+	v2 off = char_off(quad->value);
+	__m128 ex = _mm_castpd_ps(_mm_load_sd((const double*)&quad->_extra));
+	return _mm_movelh_ps(_mm_setr_ps(off.x, off.y, 0.f, 0.f), ex);
+}
+
+__attribute__((target("sse2")))
+static void conv_sse2(
+	struct raw_char *dst,
+	const struct txt_quad *src,
+	size_t n
+) {
+	for (size_t i = 0; i < n; ++i) {
+		const float *in = (const float*)(src + i);
+		float *out = (float*)(dst + i);
+
+		_mm_stream_ps(out +  0, _mm_loadu_ps(in +  0));
+		_mm_stream_ps(out +  4, _mm_loadu_ps(in +  4));
+		_mm_stream_ps(out +  8, _mm_loadu_ps(in +  8));
+		_mm_stream_ps(out + 12, _mm_loadu_ps(in + 12));
+		_mm_stream_ps(out + 16, _mm_loadu_ps(in + 16));
+		_mm_stream_ps(out + 20, conv_tail(src + i));
+	}
+
+	_mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void conv_avx2(
+	struct raw_char *dst,
+	const struct txt_quad *src,
+	size_t n
+) {
+	for (size_t i = 0; i < n; ++i) {
+		const float *in = (const float*)(src + i);
+		float *out = (float*)(dst + i);
+
+		__m256 col_tail = _mm256_insertf128_ps(
+			_mm256_castps128_ps256(_mm_loadu_ps(in + 16)),
+			conv_tail(src + i),
+			1
+		);
+
+		_mm256_stream_ps(out +  0, _mm256_loadu_ps(in + 0));
+		_mm256_stream_ps(out +  8, _mm256_loadu_ps(in + 8));
+		_mm256_stream_ps(out + 16, col_tail);
+	}
+
+	_mm_sfence();
+}
+#endif
+
+static struct conv conv_select(size_t align)
+{
+#ifdef PLATFORM_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && !(align % 32))
+		return (struct conv) { conv_avx2, "avx2" };
+	if (__builtin_cpu_supports("sse2") && !(align % 16))
+		return (struct conv) { conv_sse2, "sse2" };
+#endif
+	return (struct conv) { conv_scalar, "scalar" };
+}
+
+#ifdef TXT_DEBUG
+static void conv_check(struct conv conv)
+{
+	if (conv.fn == conv_scalar) return;
+
+	// Odd count, so that the last quad doesn't end on a cache line
+	const size_t n = 67;
+	size_t size = n * sizeof(struct raw_char);
+
+	struct txt_quad *src = malloc(n * sizeof(struct txt_quad));
+	void *raw = malloc(2 * size + 64);
+	assert(src);
+	assert(raw);
+
+	struct raw_char *ref = (void*)ak_align_up((uintptr_t)raw, 64);
+	struct raw_char *out = ref + n;
+
+	float *f = (float*)src;
+	for (size_t i = 0; i < n * sizeof(struct txt_quad) / 4; ++i)
+		f[i] = (i % 7) * -.37f + (i % 13) * 1e-3f * i;
+
+	for (size_t i = 0; i < n; ++i)
+		src[i].value = (i * 37) & 0xFF;
+
+	conv_scalar(ref, src, n);
+	conv.fn(out, src, n);
+
+	if (memcmp(ref, out, size)) {
+		fprintf(stderr, "Error: %s conversion kernel mismatch\n", conv.name);
+		panic();
+	}
+
+	free(raw);
+	free(src);
+	printf("Verified %s conversion kernel against scalar\n", conv.name);
+}
+#endif
+
+struct raw_char_packed {
+	float pos[3];
+	u16 scale;  // Half
+	u8  value;
+	u8 _pad;
+	u16 rot[4]; // Half
+	u8  col[4]; // Unorm
+	u16 fx[2];  // Half
+};
+
+_Static_assert(
+	sizeof(struct raw_char_packed) == 32,
+	"packed quad must match the layout in char.glsl"
+);
+
+static u16 half(float f) // Round to nearest even
+{
+	union { float f; u32 u; } in = { f };
+	u32 sign = (in.u >> 16) & 0x8000;
+	u32 abs = in.u & 0x7FFFFFFF;
+
+	if (abs >= 0x7F800000) // Inf, NaN
+		return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+	if (abs >= 0x477FF000) // Rounds up past max half
+		return sign | 0x7C00;
+
+	u32 exp = abs >> 23;
+	u32 man = (abs & 0x7FFFFF) | 0x800000;
+	u32 shift = 13;
+	u32 out;
+
+	if (exp < 113) { // Subnormal
+		shift = 126 - exp;
+		if (shift > 24) return sign;
+		out = man >> shift;
+	} else {
+		out = ((exp - 112) << 10) | ((man & 0x7FFFFF) >> shift);
+	}
+
+	u32 rem = man & ((1u << shift) - 1);
+	u32 mid = 1u << (shift - 1);
+	out += rem > mid || (rem == mid && (out & 1));
+
+	return sign | out;
+}
+
+static ALG_INLINE u8 unorm(float f)
+{
+	return minf(maxf(f, 0.f), 1.f) * 255.f + .5f;
+}
+
+static void pack_scalar(
+	struct raw_char_packed *dst,
+	const struct txt_quad *src,
+	size_t n
+) {
+	for (size_t i = 0; i < n; ++i) {
+		const struct txt_quad *quad = src + i;
+		const float *m = (const float*)&quad->model; // Column-major
+
+		/* Decompose TRS */
+
+		float s = sqrtf(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+		float inv = s > 0.f ? 1.f / s : 0.f;
+		float r00 = m[0] * inv, r01 = m[4] * inv, r02 = m[ 8] * inv;
+		float r10 = m[1] * inv, r11 = m[5] * inv, r12 = m[ 9] * inv;
+		float r20 = m[2] * inv, r21 = m[6] * inv, r22 = m[10] * inv;
+
+		v4 q;
+		float tr = r00 + r11 + r22;
+		if (0.f == s) {
+			q = (v4) { 0.f, 0.f, 0.f, 1.f };
+		} else if (tr > 0.f) {
+			float k = 2.f * sqrtf(tr + 1.f);
+			q = (v4) {
+				(r21 - r12) / k,
+				(r02 - r20) / k,
+				(r10 - r01) / k,
+				.25f * k,
+			};
+		} else if (r00 > r11 && r00 > r22) {
+			float k = 2.f * sqrtf(1.f + r00 - r11 - r22);
+			q = (v4) {
+				.25f * k,
+				(r01 + r10) / k,
+				(r02 + r20) / k,
+				(r21 - r12) / k,
+			};
+		} else if (r11 > r22) {
+			float k = 2.f * sqrtf(1.f + r11 - r00 - r22);
+			q = (v4) {
+				(r01 + r10) / k,
+				.25f * k,
+				(r12 + r21) / k,
+				(r02 - r20) / k,
+			};
+		} else {
+			float k = 2.f * sqrtf(1.f + r22 - r00 - r11);
+			q = (v4) {
+				(r02 + r20) / k,
+				(r12 + r21) / k,
+				.25f * k,
+				(r10 - r01) / k,
+			};
+		}
+
+		dst[i] = (struct raw_char_packed) {
+			  .pos = { m[12], m[13], m[14] },
+			.scale = half(s),
+			.value = quad->value,
+			  .rot = { half(q.x), half(q.y), half(q.z), half(q.w) },
+			  .col = {
+				unorm(quad->color.x),
+				unorm(quad->color.y),
+				unorm(quad->color.z),
+				unorm(quad->color.w),
+			},
+			   .fx = { half(quad->_extra.x), half(quad->_extra.y) },
+		};
+	}
+}
+
+/* Conversion jobs */
+
+struct job {
+	void *dst;
+	const struct txt_quad *src;
+	size_t n;
+	enum {
+		  JOB_CONV // raw_char
+		, JOB_PACK // raw_char_packed
+		, JOB_COPY // txt_quad, for zero-copy mode
+	} mode;
+};
+
+static void job_run(struct job job, size_t beg, size_t end)
+{
+	if (beg >= end) return;
+	const struct txt_quad *src = job.src + beg;
+	size_t n = end - beg;
+
+	switch (job.mode) {
+	case JOB_CONV:
+		conv.fn((struct raw_char*)job.dst + beg, src, n);
+		break;
+	case JOB_PACK:
+		pack_scalar((struct raw_char_packed*)job.dst + beg, src, n);
+		break;
+	case JOB_COPY:
+		memcpy((struct txt_quad*)job.dst + beg, src, n * sizeof(*src));
+		break;
+	}
+}
+
+/* Persistent worker pool;
+ * the calling thread always converts the first chunk itself
+ */
+
+static struct work {
+	struct job job;
+	size_t chunk;
+	u32 thread_n;
+#ifdef PLATFORM_THREADS
+	pthread_t *threads;
+	pthread_mutex_t lock;
+	pthread_cond_t go;
+	pthread_cond_t idle;
+	u64 gen;
+	u32 busy;
+	int quit;
+#endif
+} work;
+
+#ifdef PLATFORM_THREADS
+static void *work_loop(void *arg)
+{
+	size_t part = 1 + (uintptr_t)arg;
+	u64 seen = 0;
+
+	pthread_mutex_lock(&work.lock);
+	for (;;) {
+		while (work.gen == seen && !work.quit)
+			pthread_cond_wait(&work.go, &work.lock);
+		if (work.quit) break;
+
+		seen = work.gen;
+		struct job job = work.job;
+		size_t chunk = work.chunk;
+		pthread_mutex_unlock(&work.lock);
+
+		size_t beg = part * chunk;
+		size_t end = beg + chunk;
+		job_run(job, beg, end < job.n ? end : job.n);
+
+		pthread_mutex_lock(&work.lock);
+		if (!--work.busy) pthread_cond_signal(&work.idle);
+	}
+
+	pthread_mutex_unlock(&work.lock);
+	return NULL;
+}
+#endif
+
+static void mk_work(int req)
+{
+	work.thread_n = 0;
+#ifdef PLATFORM_THREADS
+	if (req < 0) goto none;
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 n = req ?: (cores > 1 ? cores - 1 : 0);
+	n = n < MAX_WORKERS ? n : MAX_WORKERS;
+	if (!n) goto none;
+
+	work.threads = malloc(n * sizeof(pthread_t));
+	assert(work.threads);
+
+	pthread_mutex_init(&work.lock, NULL);
+	pthread_cond_init(&work.go, NULL);
+	pthread_cond_init(&work.idle, NULL);
+
+	for (u32 i = 0; i < n; ++i) {
+		int err = pthread_create(
+			work.threads + i,
+			NULL,
+			work_loop,
+			(void*)(uintptr_t)i
+		);
+
+		if (err) {
+			panic_msg("unable to create worker thread");
+		}
+	}
+
+	work.thread_n = n;
+	printf("Created %u conversion worker(s)\n", n);
+	return;
+none:
+#endif
+	printf("Quad conversion is single-threaded\n");
+}
+
+static void work_free()
+{
+#ifdef PLATFORM_THREADS
+	if (!work.thread_n) return;
+
+	pthread_mutex_lock(&work.lock);
+	work.quit = 1;
+	pthread_cond_broadcast(&work.go);
+	pthread_mutex_unlock(&work.lock);
+
+	for (u32 i = 0; i < work.thread_n; ++i)
+		pthread_join(work.threads[i], NULL);
+
+	pthread_mutex_destroy(&work.lock);
+	pthread_cond_destroy(&work.go);
+	pthread_cond_destroy(&work.idle);
+	free(work.threads);
+#endif
+}
+
+static void txt_grow(struct txt_buf *buf, size_t cap)
+{
+	buf->quads = realloc(buf->quads, cap * sizeof(struct txt_quad));
+	assert(buf->quads);
+	buf->cap = cap;
+}
+
+static void txt_update(void *buf, const struct txt_buf *txt, int mode)
+{
+	struct job job = { buf, txt->quads, txt->count, mode };
+
+#ifdef PLATFORM_THREADS
+	if (work.thread_n && job.n >= PARALLEL_MIN_QUAD) {
+		// Even chunks, so that full quads end on a cache line
+		size_t parts = work.thread_n + 1;
+		size_t chunk = ak_align_up((job.n + parts - 1) / parts, 2);
+
+		pthread_mutex_lock(&work.lock);
+		work.job = job;
+		work.chunk = chunk;
+		work.busy = work.thread_n;
+		++work.gen;
+		pthread_cond_broadcast(&work.go);
+		pthread_mutex_unlock(&work.lock);
+
+		job_run(job, 0, chunk < job.n ? chunk : job.n);
+
+		pthread_mutex_lock(&work.lock);
+		while (work.busy) pthread_cond_wait(&work.idle, &work.lock);
+		pthread_mutex_unlock(&work.lock);
+		return;
+	}
+#endif
+	job_run(job, 0, job.n);
+}
+
+/* Retained quads */
+
+static struct retain {
+	struct txt_quad *quads;
+	u8 *live;
+	u32 *free; // Stack of unused handles
+	u32 free_n;
+	u32 cap;
+	u32 hi; // One past the highest live handle
+	struct range {
+		u32 lo;
+		u32 hi;
+	} dirty[MAX_FRAMES_IN_FLIGHT];
+	u32 frames;
+} retain;
+
+static void mk_retain(u32 cap, u32 frames)
+{
+	retain.cap = cap;
+	retain.frames = frames;
+	for (size_t i = 0; i < frames; ++i)
+		retain.dirty[i] = (struct range) { UINT32_MAX, 0 };
+	if (!cap) return;
+
+	retain.quads = calloc(cap, sizeof(struct txt_quad));
+	retain.live = calloc(cap, 1);
+	retain.free = malloc(cap * sizeof(u32));
+	assert(retain.quads);
+	assert(retain.live);
+	assert(retain.free);
+
+	// Hand out low handles first
+	for (u32 i = 0; i < cap; ++i)
+		retain.free[i] = cap - 1 - i;
+	retain.free_n = cap;
+
+	printf("Created retained quad pool (%u)\n", cap);
+}
+
+static void retain_free()
+{
+	free(retain.quads);
+	free(retain.live);
+	free(retain.free);
+}
+
+static void retain_mark(u32 i)
+{
+	for (size_t j = 0; j < retain.frames; ++j) {
+		struct range *r = retain.dirty + j;
+		r->lo = i < r->lo ? i : r->lo;
+		r->hi = i + 1 > r->hi ? i + 1 : r->hi;
+	}
+}
+
+// Returns the range that was written
+static struct range retain_update(void *buf, size_t frame, int mode)
+{
+	struct range r = retain.dirty[frame];
+	if (r.lo >= r.hi) return (struct range) { 0, 0 };
+
+	struct job job = { buf, retain.quads, r.hi, mode };
+	job_run(job, r.lo, r.hi);
+
+	retain.dirty[frame] = (struct range) { UINT32_MAX, 0 };
+	return r;
+}
+
+txt_handle txtquad_quad_new()
+{
+	if (!retain.free_n) {
+		panic_msg("out of retained quads");
+	}
+
+	txt_handle h = retain.free[--retain.free_n];
+	retain.live[h] = 1;
+	retain.hi = h + 1 > retain.hi ? h + 1 : retain.hi;
+
+	memset(retain.quads + h, 0, sizeof(struct txt_quad));
+	retain_mark(h);
+	return h;
+}
+
+struct txt_quad *txtquad_quad_edit(txt_handle h)
+{
+	assert(h < retain.cap && retain.live[h]);
+	retain_mark(h);
+	return retain.quads + h;
+}
+
+void txtquad_quad_free(txt_handle h)
+{
+	assert(h < retain.cap && retain.live[h]);
+	retain.live[h] = 0;
+
+	// Zero scale; hidden until reused
+	memset(retain.quads + h, 0, sizeof(struct txt_quad));
+	retain_mark(h);
 
-	size_t end = txt.count;
-	size_t clear_size = (MAX_QUAD - end) * sizeof(struct raw_char);
-	memset(buf + end, 0, clear_size);
+	retain.free[retain.free_n++] = h;
+	while (retain.hi && !retain.live[retain.hi - 1]) --retain.hi;
 }
 
 struct pipeline_template {
@@ -80,6 +679,8 @@ struct pipeline_template {
 	VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info;
 	VkPipelineColorBlendAttachmentState blend_attach;
 	VkPipelineColorBlendStateCreateInfo blend_state_create_info;
+	VkDynamicState dyn[2];
+	VkPipelineDynamicStateCreateInfo dyn_state_create_info;
 	VkGraphicsPipelineCreateInfo data;
 };
 
@@ -96,27 +697,45 @@ static struct {
 		VkDevice log;
 		size_t q_ind;
 		VkQueue q;
+		size_t xfer_ind; // Dedicated transfer family if found, else q_ind
+		VkQueue xfer;
+		int timeline; // VK_KHR_timeline_semaphore enabled
 		VkSampleCountFlagBits sample_n;
+		u32 ts_bits; // Valid timestamp bits on the queue; zero if unsupported
 	} dev;
 	struct swap {
 		VkSwapchainKHR chain;
 		VkFormat format;
 		struct extent extent;
 		VkImage *img;
+		u32 img_count;
+		VkPresentModeKHR present;
 		struct ak_img aa;
 		struct ak_img depth;
+		struct ak_img scene; // Dynamic resolution only; upscaled into img
+		struct ak_img off; // Headless only; chain is null
 	} swap;
 	VkCommandPool pool;
 	struct font {
 		struct ak_img tex;
 		VkSampler sampler;
+		struct ak_buf metrics; // Glyph bounds (UBO)
 	} font;
 	struct buf {
 		struct ak_buf gpu;
 		void *mapped;
 		u64 align;
 		u64 frame_size;
-	} share, rchar;
+		u64 tail; // Offset of the retained quads within each frame
+		size_t stride;
+		size_t cap; // Quads per frame, before the tail
+		struct ak_buf local; // Staged copy of gpu; null unless staged
+	} share, rchar, indirect, list;
+	struct stage { // Null unless the quads are staged
+		VkCommandPool pool;
+		VkCommandBuffer cmd[MAX_FRAMES_IN_FLIGHT];
+		int full[MAX_FRAMES_IN_FLIGHT]; // Copy the whole frame next
+	} stage;
 	struct desc {
 		VkDescriptorSetLayout *layouts;
 		u32 lay_count;
@@ -138,19 +757,203 @@ static struct {
 		VkPipelineLayout layout;
 		VkPipeline line;
 	} pipe;
+	struct cull { // Null unless txt_cfg.cull
+		struct ak_shader comp;
+		VkPipelineLayout layout;
+		VkPipeline line;
+	} cull;
+	VkPipelineCache cache;
 	struct frame {
 		VkImageView *views;
 		VkFramebuffer *buffers;
 	} frame;
+	struct txt_cfg cfg;
 	v3 clear_col;
 	VkCommandBuffer *cmd;
 	struct sync {
-		VkFence acquire;
-		VkFence *submit;
-		VkSemaphore *sem;
+		u32 frame_n; // In flight
+		u32 img_n;
+		VkSemaphore *acquire; // Per frame
+		VkFence *submit;      // Per frame
+		VkSemaphore *sem;     // Per swapchain image
 	} sync;
+	struct query {
+		VkQueryPool ts;   // Two timestamps per frame in flight
+		VkQueryPool pipe; // Pipeline statistics, per frame in flight
+		u64 ts_mask;
+		float period; // Nanoseconds per tick
+	} query;
 } app;
 
+struct Input;
+
+/* Update thread;
+ * txtquad_update() runs one frame ahead of the render thread,
+ * which hands over timing and input through a pair of slots
+ */
+
+static struct produce {
+	struct slot {
+		struct txt_frame frame;
+		struct txt_buf *txt;
+		struct txt_share share;
+#ifdef INP_KEYS
+		struct Input inp;
+#endif
+#ifdef INP_TEXT
+		unsigned text[TEXT_QUEUE];
+		size_t text_n;
+#endif
+	} slots[2]; // Written by the producer, read by the render thread
+	int on;
+#ifdef INP_TEXT
+	unsigned text[TEXT_QUEUE]; // Pending for the next slot
+	size_t text_n;
+#endif
+#ifdef PLATFORM_THREADS
+	pthread_t thread;
+	pthread_mutex_t lock; // Only for sleeping; the handoff is lock-free
+	pthread_cond_t cond;
+	atomic_size_t issued;
+	atomic_size_t completed;
+	size_t consumed; // Render thread only
+	int quit;
+#endif
+} produce;
+
+#ifdef PLATFORM_THREADS
+static void produce_signal()
+{
+	pthread_mutex_lock(&produce.lock);
+	pthread_cond_broadcast(&produce.cond);
+	pthread_mutex_unlock(&produce.lock);
+}
+
+// Returns zero if woken up to quit
+static int produce_wait(atomic_size_t *count, size_t above)
+{
+	if (atomic_load_explicit(count, memory_order_acquire) > above)
+		return 1;
+
+	pthread_mutex_lock(&produce.lock);
+	while (
+		atomic_load_explicit(count, memory_order_acquire) <= above
+		&& !produce.quit
+	) {
+		pthread_cond_wait(&produce.cond, &produce.lock);
+	}
+
+	int quit = produce.quit;
+	pthread_mutex_unlock(&produce.lock);
+	return !quit || atomic_load(count) > above;
+}
+
+static void *produce_loop(void *arg)
+{
+	for (size_t k = 0; produce_wait(&produce.issued, k); ++k) {
+		struct slot *slot = produce.slots + k % 2;
+#ifdef INP_KEYS
+		inp_data = slot->inp;
+#endif
+#ifdef INP_TEXT
+		for (size_t i = 0; i < slot->text_n; ++i)
+			inp_ev_text(slot->text[i]);
+#endif
+		slot->share = txtquad_update(slot->frame, slot->txt);
+		assert(slot->txt->count <= slot->txt->cap);
+
+		atomic_store_explicit(
+			&produce.completed,
+			k + 1,
+			memory_order_release
+		);
+
+		produce_signal();
+	}
+
+	return NULL;
+}
+#endif
+
+static void mk_produce(int on, size_t cap)
+{
+	produce.on = on;
+	if (!on) return;
+#ifdef PLATFORM_THREADS
+	for (size_t i = 0; i < 2; ++i) {
+		struct txt_buf *buf = calloc(1, sizeof(struct txt_buf));
+		assert(buf);
+		txt_grow(buf, cap);
+		produce.slots[i].txt = buf;
+	}
+
+	pthread_mutex_init(&produce.lock, NULL);
+	pthread_cond_init(&produce.cond, NULL);
+
+	int err = pthread_create(&produce.thread, NULL, produce_loop, NULL);
+	if (err) {
+		panic_msg("unable to create update thread");
+	}
+
+	printf("Created update thread\n");
+#else
+	panic_msg("threaded update is unsupported on this platform");
+#endif
+}
+
+static void produce_free()
+{
+#ifdef PLATFORM_THREADS
+	if (!produce.on) return;
+
+	// Any issued frame is finished first
+	pthread_mutex_lock(&produce.lock);
+	produce.quit = 1;
+	pthread_cond_broadcast(&produce.cond);
+	pthread_mutex_unlock(&produce.lock);
+	pthread_join(produce.thread, NULL);
+
+	pthread_mutex_destroy(&produce.lock);
+	pthread_cond_destroy(&produce.cond);
+	for (size_t i = 0; i < 2; ++i) {
+		free(produce.slots[i].txt->quads);
+		free(produce.slots[i].txt);
+	}
+#endif
+}
+
+#ifdef PLATFORM_THREADS
+static void produce_issue(struct txt_frame frame, struct Input *inp)
+{
+	size_t k = atomic_load_explicit(&produce.issued, memory_order_relaxed);
+	struct slot *slot = produce.slots + k % 2;
+	slot->frame = frame;
+#ifdef INP_KEYS
+	slot->inp = *inp;
+#endif
+#ifdef INP_TEXT
+	memcpy(slot->text, produce.text, produce.text_n * sizeof(unsigned));
+	slot->text_n = produce.text_n;
+	produce.text_n = 0;
+#endif
+	atomic_store_explicit(&produce.issued, k + 1, memory_order_release);
+	produce_signal();
+}
+
+// Blocks until the oldest issued frame has been updated
+static struct slot *produce_consume()
+{
+	produce_wait(&produce.completed, produce.consumed);
+	return produce.slots + produce.consumed % 2;
+}
+
+static int produce_pending()
+{
+	size_t k = atomic_load_explicit(&produce.issued, memory_order_relaxed);
+	return k > produce.consumed;
+}
+#endif
+
 #ifdef INP_KEYS
 struct Input inp_data;
 
@@ -176,7 +979,14 @@ void inp_pad_init(const int *pad_handles, size_t pad_count)
 #ifdef INP_TEXT
 static void glfw_char_callback(GLFWwindow *win, unsigned int unicode)
 {
-	inp_ev_text(unicode);
+	if (!produce.on) {
+		inp_ev_text(unicode);
+		return;
+	}
+
+	// Dispatched on the update thread; dropped if the queue is full
+	if (produce.text_n < TEXT_QUEUE)
+		produce.text[produce.text_n++] = unicode;
 }
 #endif
 
@@ -278,7 +1088,9 @@ static GLFWwindow *mk_win(
 	return win;
 }
 
-static VkInstance mk_inst(const char *name)
+static int has_props2; // VK_KHR_get_physical_device_properties2
+
+static VkInstance mk_inst(const char *name, int headless)
 {
 	VkApplicationInfo app_info = {
 	STYPE(APPLICATION_INFO)
@@ -297,16 +1109,27 @@ static VkInstance mk_inst(const char *name)
 	);
 
 	// Get WSI extensions
-	unsigned int inst_ext_count;
-	const char **inst_ext_names = glfwGetRequiredInstanceExtensions(
-		&inst_ext_count
-	);
+	unsigned int inst_ext_count = 0;
+	const char **inst_ext_names = headless ? NULL
+		: glfwGetRequiredInstanceExtensions(&inst_ext_count);
 
 	printf("WSI instance extensions:\n");
 	for (size_t i = 0; i < inst_ext_count; ++i) {
 		printf("\t%s\n", inst_ext_names[i]);
 	}
 
+	const char *ext_names[inst_ext_count + 1];
+	for (size_t i = 0; i < inst_ext_count; ++i)
+		ext_names[i] = inst_ext_names[i];
+
+	// For VK_EXT_memory_budget
+	has_props2 = ak_inst_ext_find(
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+	);
+
+	if (has_props2) ext_names[inst_ext_count++]
+		= VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+
 	/* TODO: validate instance extensions */
 
 	u32 layer_count;
@@ -344,7 +1167,7 @@ static VkInstance mk_inst(const char *name)
 	STYPE(INSTANCE_CREATE_INFO)
 		.pApplicationInfo = &app_info,
 		.enabledExtensionCount = inst_ext_count,
-		.ppEnabledExtensionNames = inst_ext_names,
+		.ppEnabledExtensionNames = ext_names,
 		.enabledLayerCount = layer_count,
 		.ppEnabledLayerNames = layer_names,
 		.pNext = NULL,
@@ -372,7 +1195,7 @@ static VkSurfaceKHR mk_surf(GLFWwindow *win, VkInstance inst)
 	return surf;
 }
 
-static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf)
+static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf, u32 msaa)
 {
 	unsigned int dev_count;
 	VkPhysicalDevice *hard_devs, hard_dev;
@@ -403,68 +1226,154 @@ static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf)
 		VK_VERSION_PATCH(props.apiVersion)
 	);
 
-	VkSampleCountFlags sample_n =
+	VkSampleCountFlags counts =
 		  props.limits.framebufferColorSampleCounts
 		& props.limits.framebufferDepthSampleCounts;
 
-	     if (sample_n & VK_SAMPLE_COUNT_4_BIT)
-	         sample_n = VK_SAMPLE_COUNT_4_BIT;
-	else if (sample_n & VK_SAMPLE_COUNT_2_BIT)
-	         sample_n = VK_SAMPLE_COUNT_2_BIT;
-	else     sample_n = VK_SAMPLE_COUNT_1_BIT;
+	// Highest supported count not above the request
+	VkSampleCountFlagBits sample_n = VK_SAMPLE_COUNT_1_BIT;
+	for (u32 n = VK_SAMPLE_COUNT_64_BIT; n > 1; n >>= 1) {
+		if (n > msaa || !(counts & n)) continue;
+		sample_n = n;
+		break;
+	}
+
+	printf("Using %ux multisampling\n", sample_n);
 
 	VkPhysicalDeviceFeatures feats;
 	vkGetPhysicalDeviceFeatures(hard_dev, &feats);
 
-	unsigned int q_family_count = 1;
-	VkQueueFamilyProperties q_prop;
+	unsigned int q_family_count;
+	vkGetPhysicalDeviceQueueFamilyProperties(hard_dev, &q_family_count, NULL);
+	VkQueueFamilyProperties q_props[q_family_count];
 	vkGetPhysicalDeviceQueueFamilyProperties(
 		hard_dev,
 		&q_family_count,
-		&q_prop
+		q_props
 	);
 
-	size_t q_ind = 0;
-	VkBool32 can_present;
-	vkGetPhysicalDeviceSurfaceSupportKHR(
-		hard_dev,
-		q_ind,
-		surf,
-		&can_present
-	);
+	/* Graphics (and present) on the first capable family;
+	 * uploads on a transfer-only family if there is one,
+	 * which usually maps to a copy engine
+	 */
+
+	size_t q_ind = q_family_count, xfer_ind = q_family_count;
+	for (u32 i = 0; i < q_family_count; ++i) {
+		VkQueueFlags flags = q_props[i].queueFlags;
+		printf(
+			"Found queue family [%u] with %u queue(s):%s%s%s\n",
+			i,
+			q_props[i].queueCount,
+			flags & VK_QUEUE_GRAPHICS_BIT ? " graphics" : "",
+			flags & VK_QUEUE_COMPUTE_BIT  ? " compute"  : "",
+			flags & VK_QUEUE_TRANSFER_BIT ? " transfer" : ""
+		);
+
+		VkBool32 can_present = VK_TRUE;
+		if (surf) vkGetPhysicalDeviceSurfaceSupportKHR(
+			hard_dev,
+			i,
+			surf,
+			&can_present
+		);
+
+		if (q_ind == q_family_count
+			&& flags & VK_QUEUE_GRAPHICS_BIT && can_present)
+			q_ind = i;
 
-	if (!can_present) {
-		panic_msg("default queue family cannot present to window");
+		VkQueueFlags busy = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+		if (xfer_ind == q_family_count
+			&& flags & VK_QUEUE_TRANSFER_BIT && !(flags & busy))
+			xfer_ind = i;
 	}
 
-	/* TODO: a more robust queue infrastructure */
+	if (q_ind == q_family_count) {
+		panic_msg("no queue family can draw and present to window");
+	}
+
+	int xfer_own = xfer_ind != q_family_count;
+	if (!xfer_own) xfer_ind = q_ind; // Share the graphics queue
 
-	printf("Found queue [%zu]\n", q_ind);
+	printf("Using queue family [%zu] for graphics\n", q_ind);
+	printf(
+		"Using queue family [%zu] for uploads (%s)\n",
+		xfer_ind,
+		xfer_own ? "dedicated" : "shared"
+	);
 
 	float pri = 1.f;
-	VkDeviceQueueCreateInfo q_create_info = {
-	STYPE(DEVICE_QUEUE_CREATE_INFO)
-		.queueFamilyIndex = q_ind,
-		.queueCount = 1,
-		.pQueuePriorities = &pri,
-		.pNext = NULL,
+	VkDeviceQueueCreateInfo q_create_infos[2] = {
+		{
+		STYPE(DEVICE_QUEUE_CREATE_INFO)
+			.queueFamilyIndex = q_ind,
+			.queueCount = 1,
+			.pQueuePriorities = &pri,
+			.pNext = NULL,
+		}, {
+		STYPE(DEVICE_QUEUE_CREATE_INFO)
+			.queueFamilyIndex = xfer_ind,
+			.queueCount = 1,
+			.pQueuePriorities = &pri,
+			.pNext = NULL,
+		}
 	};
 
-	const char *dev_ext_names[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	// Upload completion; fences otherwise
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_feats = {
+	STYPE(PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR)
+		.timelineSemaphore = VK_FALSE,
+		.pNext = NULL,
+	};
 
-	/* TODO: validate device extensions */
+	if (has_props2 && ak_dev_ext_find(
+		hard_dev,
+		VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
+	)) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR get_feats2 =
+			(PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+				inst,
+				"vkGetPhysicalDeviceFeatures2KHR"
+			);
+
+		VkPhysicalDeviceFeatures2KHR feats2 = {
+		STYPE(PHYSICAL_DEVICE_FEATURES_2_KHR)
+			.pNext = &timeline_feats,
+		};
+
+		get_feats2(hard_dev, &feats2);
+	}
+
+	int timeline = timeline_feats.timelineSemaphore;
+	printf("Timeline semaphores %ssupported\n", timeline ? "" : "un");
+
+	int budget = has_props2 && ak_dev_ext_find(
+		hard_dev,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+	);
+
+	printf("Memory budget %ssupported\n", budget ? "" : "un");
+
+	const char *dev_ext_names[3];
+	u32 dev_ext_count = 0;
+
+	// No swapchain if headless
+	if (surf) dev_ext_names[dev_ext_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+	if (budget) dev_ext_names[dev_ext_count++]
+		= VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+	if (timeline) dev_ext_names[dev_ext_count++]
+		= VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
 
 	VkDeviceCreateInfo dev_create_info = {
 	STYPE(DEVICE_CREATE_INFO)
 		.flags = 0,
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &q_create_info,
+		.queueCreateInfoCount = xfer_own ? 2 : 1,
+		.pQueueCreateInfos = q_create_infos,
 		.enabledLayerCount = 0,
 		.ppEnabledLayerNames = NULL,
-		.enabledExtensionCount = 1,
+		.enabledExtensionCount = dev_ext_count,
 		.ppEnabledExtensionNames = dev_ext_names,
 		.pEnabledFeatures = &feats,
-		.pNext = NULL,
+		.pNext = timeline ? &timeline_feats : NULL,
 	};
 
 	VkDevice dev;
@@ -475,9 +1384,10 @@ static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf)
 
 	printf("Created logical device\n");
 
-	VkQueue q;
+	VkQueue q, xfer;
 	vkGetDeviceQueue(dev, q_ind, 0, &q);
-	printf("Acquired queue [%zu]\n", q_ind);
+	vkGetDeviceQueue(dev, xfer_ind, 0, &xfer);
+	printf("Acquired queues [%zu] and [%zu]\n", q_ind, xfer_ind);
 
 	VkPhysicalDeviceMemoryProperties props_mem;
 	vkGetPhysicalDeviceMemoryProperties(hard_dev, &props_mem);
@@ -495,6 +1405,18 @@ static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf)
 		printf("Found heap %u with size %.1fMB\n", i, size);
 	}
 
+	ak_arena_init(
+		hard_dev,
+		dev,
+		props_mem,
+		props.limits.nonCoherentAtomSize,
+		budget ? (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+			vkGetInstanceProcAddr(
+				inst,
+				"vkGetPhysicalDeviceMemoryProperties2KHR"
+			) : NULL
+	);
+
 	return (struct dev) {
 		hard_devs,
 		hard_dev,
@@ -504,16 +1426,149 @@ static struct dev mk_dev(VkInstance inst, VkSurfaceKHR surf)
 		dev,
 		q_ind,
 		q,
+		xfer_ind,
+		xfer,
+		timeline,
 		sample_n,
+		props.limits.timestampComputeAndGraphics ?
+			q_props[q_ind].timestampValidBits : 0,
 	};
 }
 
+static void mk_targets(
+	struct dev dev,
+	u32 win_w,
+	u32 win_h,
+	VkFormat format,
+	int scaled,
+	struct ak_img *aa,
+	struct ak_img *depth,
+	struct ak_img *scene
+) {
+	// Single-sampled passes render straight to the target
+	*aa = (struct ak_img) { 0 };
+	if (dev.sample_n > 1) AK_IMG_MK(
+		dev.log,
+		dev.props_mem,
+		"aa buffer",
+		win_w, win_h, dev.sample_n,
+		format,
+		  AK_IMG_USAGE(TRANSIENT_ATTACHMENT)
+		| AK_IMG_USAGE(COLOR_ATTACHMENT),
+		COLOR,
+		aa
+	);
+
+	AK_IMG_MK(
+		dev.log,
+		dev.props_mem,
+		"depth texture",
+		win_w, win_h, dev.sample_n,
+		VK_FORMAT_D32_SFLOAT,
+		AK_IMG_USAGE(DEPTH_STENCIL_ATTACHMENT),
+		DEPTH,
+		depth
+	);
+
+	// Rendered at full size, then only in part (see record_graphics())
+	*scene = (struct ak_img) { 0 };
+	if (scaled) AK_IMG_MK(
+		dev.log,
+		dev.props_mem,
+		"scene target",
+		win_w, win_h, VK_SAMPLE_COUNT_1_BIT,
+		format,
+		  AK_IMG_USAGE(COLOR_ATTACHMENT)
+		| AK_IMG_USAGE(TRANSFER_SRC),
+		COLOR,
+		scene
+	);
+}
+
+static VkPresentModeKHR pick_present(
+	struct dev dev,
+	VkSurfaceKHR surf,
+	int req
+) {
+	u32 mode_count;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(
+		dev.hard,
+		surf,
+		&mode_count,
+		NULL
+	);
+
+	VkPresentModeKHR modes[mode_count];
+	vkGetPhysicalDeviceSurfacePresentModesKHR(
+		dev.hard,
+		surf,
+		&mode_count,
+		modes
+	);
+
+	/* Fall back towards FIFO, which is always supported;
+	 * uncapped modes prefer to stay uncapped
+	 */
+
+	VkPresentModeKHR chain[3];
+	size_t chain_len = 0;
+
+	switch (req) {
+	case PRESENT_IMMEDIATE:
+		chain[chain_len++] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		// Fallthrough
+	case PRESENT_MAILBOX:
+		chain[chain_len++] = VK_PRESENT_MODE_MAILBOX_KHR;
+		break;
+	case PRESENT_FIFO_RELAXED:
+		chain[chain_len++] = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		break;
+	case PRESENT_FIFO:
+		break;
+	default:
+		panic();
+	}
+
+	chain[chain_len++] = VK_PRESENT_MODE_FIFO_KHR;
+
+	for (size_t i = 0; i < chain_len; ++i) {
+		for (u32 j = 0; j < mode_count; ++j) {
+			if (modes[j] != chain[i]) continue;
+			if (i) printf("Warning: requested present mode unsupported\n");
+			return chain[i];
+		}
+	}
+
+	panic_msg("no supported present mode");
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static const char *present_str(VkPresentModeKHR mode)
+{
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "fifo relaxed";
+	default:
+		return "unknown";
+	}
+}
+
 static struct swap mk_swap(
 	struct extent req,
 	struct extent fbuffer,
 	struct dev dev,
 	GLFWwindow *win,
-	VkSurfaceKHR surf
+	VkSurfaceKHR surf,
+	int present_req,
+	u32 img_req,
+	int scaled,
+	const struct swap *old // Retired by the new swapchain; null at init
 ) {
 	u32 win_w, win_h;
 	VkSurfaceCapabilitiesKHR cap;
@@ -548,11 +1603,17 @@ static struct swap mk_swap(
 	printf("Image count range: %u-", cap.minImageCount);
 	if (cap.maxImageCount) {
 	       printf("%u\n", cap.maxImageCount);
-	       assert(cap.maxImageCount >= SWAP_IMG_COUNT);
 	} else printf("inf\n");
-	assert(SWAP_IMG_COUNT >= cap.minImageCount);
 
-	unsigned int img_count = SWAP_IMG_COUNT;
+	unsigned int img_count = img_req ?: SWAP_IMG_COUNT;
+	if (img_count < cap.minImageCount)
+		img_count = cap.minImageCount;
+	if (cap.maxImageCount && img_count > cap.maxImageCount)
+		img_count = cap.maxImageCount;
+
+	VkPresentModeKHR present = pick_present(dev, surf, present_req);
+	printf("Using present mode: %s\n", present_str(present));
+
 	VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
 	VkSwapchainCreateInfoKHR swap_create_info = {
 	STYPE(SWAPCHAIN_CREATE_INFO_KHR)
@@ -563,18 +1624,19 @@ static struct swap mk_swap(
 		.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
 		.imageExtent = { win_w, win_h },
 		.imageArrayLayers = 1,
-		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		            | (scaled ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0),
 		.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.queueFamilyIndexCount = 0,
 		.pQueueFamilyIndices = NULL,
 		.preTransform = cap.currentTransform,
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-		.presentMode = VK_PRESENT_MODE_FIFO_KHR, // TODO
+		.presentMode = present,
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE,
+		.oldSwapchain = old ? old->chain : VK_NULL_HANDLE,
 	};
 
-	/* TODO: validate formats, presentation modes */
+	/* TODO: validate formats */
 
 	VkSwapchainKHR swapchain;
 	VkResult err = vkCreateSwapchainKHR(
@@ -591,7 +1653,6 @@ static struct swap mk_swap(
 	VkImage *img = NULL;
 	img_count = 0;
 	vkGetSwapchainImagesKHR(dev.log, swapchain, &img_count, img);
-	assert(img_count == SWAP_IMG_COUNT);
 
 	assert(!img);
 	img = malloc(sizeof(VkImage) * img_count);
@@ -599,48 +1660,78 @@ static struct swap mk_swap(
 	vkGetSwapchainImagesKHR(dev.log, swapchain, &img_count, img);
 	printf("Created swapchain with %u images\n", img_count);
 
-	struct ak_img aa;
-	AK_IMG_MK(
-		dev.log,
-		dev.props_mem,
-		"aa buffer",
-		win_w, win_h, dev.sample_n,
-		format,
-		  AK_IMG_USAGE(TRANSIENT_ATTACHMENT)
-		| AK_IMG_USAGE(COLOR_ATTACHMENT),
-		COLOR,
-		&aa
-	);
-
-	struct ak_img depth;
-	AK_IMG_MK(
-		dev.log,
-		dev.props_mem,
-		"depth texture",
-		win_w, win_h, dev.sample_n,
-		VK_FORMAT_D32_SFLOAT,
-		AK_IMG_USAGE(DEPTH_STENCIL_ATTACHMENT),
-		DEPTH,
-		&depth
-	);
+	// Targets carry over unless the size changed
+	struct ak_img aa, depth, scene;
+	if (old && old->extent.w == win_w && old->extent.h == win_h) {
+		aa = old->aa;
+		depth = old->depth;
+		scene = old->scene;
+	} else mk_targets(dev, win_w, win_h, format, scaled, &aa, &depth, &scene);
 
 	return (struct swap) {
 		swapchain,
 		format,
 		{ win_w, win_h },
 		img,
+		img_count,
+		present,
 		aa,
 		depth,
+		scene,
 	};
 }
 
-static VkCommandPool mk_pool(struct dev dev)
+// Stands in for the swapchain when headless
+static struct swap mk_offscreen(struct extent size, struct dev dev, int scaled)
 {
+	VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+	printf("Offscreen extent: %ux%u\n", size.w, size.h);
+
+	struct ak_img off;
+	AK_IMG_MK(
+		dev.log,
+		dev.props_mem,
+		"offscreen target",
+		size.w, size.h, VK_SAMPLE_COUNT_1_BIT,
+		format,
+		  AK_IMG_USAGE(COLOR_ATTACHMENT)
+		| AK_IMG_USAGE(TRANSFER_SRC)
+		| (scaled ? AK_IMG_USAGE(TRANSFER_DST) : 0),
+		COLOR,
+		&off
+	);
+
+	VkImage *img = malloc(sizeof(VkImage));
+	assert(img);
+	img[0] = off.img;
+
+	struct ak_img aa, depth, scene;
+	mk_targets(dev, size.w, size.h, format, scaled, &aa, &depth, &scene);
+
+	return (struct swap) {
+		.chain = VK_NULL_HANDLE,
+		.format = format,
+		.extent = size,
+		.img = img,
+		.img_count = 1,
+		.present = VK_PRESENT_MODE_FIFO_KHR,
+		.aa = aa,
+		.depth = depth,
+		.scene = scene,
+		.off = off,
+	};
+}
+
+static VkCommandPool mk_pool(
+	struct dev dev,
+	size_t family,
+	VkCommandPoolCreateFlags flags
+) {
 	VkResult err;
 	VkCommandPoolCreateInfo pool_create_info = {
 	STYPE(COMMAND_POOL_CREATE_INFO)
-		.flags = 0,
-		.queueFamilyIndex = dev.q_ind,
+		.flags = flags,
+		.queueFamilyIndex = family,
 		.pNext = NULL,
 	};
 
@@ -654,196 +1745,512 @@ static VkCommandPool mk_pool(struct dev dev)
 	return pool;
 }
 
-static unsigned char *read_font() // Read custom PBM file
+/* Upload service;
+ * copies are batched on the transfer queue and, when that queue belongs to
+ * another family, handed over to the graphics queue with a release/acquire
+ * pair. The graphics side is submitted right away, so later frames are
+ * ordered after it without the host waiting. Completion is tracked with a
+ * timeline semaphore where supported, else with a fence per batch
+ */
+
+#define UPLOAD_BATCHES 4 // Submitted and not yet collected, at most
+#define UPLOAD_STAGING 8 // Staging buffers per batch
+
+static struct upload {
+	VkDevice dev;
+	VkPhysicalDeviceMemoryProperties props_mem;
+	VkDeviceSize atom;
+	VkQueue xfer, q;
+	u32 xfer_ind, q_ind;
+	VkCommandPool pool, acquire_pool; // Transfer and graphics families
+	VkSemaphore timeline; // Null without timeline semaphores
+	PFN_vkGetSemaphoreCounterValueKHR counter;
+	PFN_vkWaitSemaphoresKHR wait;
+	struct batch {
+		VkCommandBuffer cmd;
+		VkCommandBuffer acquire; // Null if the families match
+		VkSemaphore sem; // Transfer to graphics, without timelines
+		VkFence fence; // Completion, without timelines
+		VkPipelineStageFlags stages; // Waited on by the acquire
+		struct ak_buf staging[UPLOAD_STAGING];
+		u32 staging_n;
+		u64 ticket; // Zero unless submitted
+		int open;
+	} q[UPLOAD_BATCHES];
+	u32 head; // Batch being recorded, or the next one
+	u64 next; // Submission count, plus one
+	u64 last; // Ticket of the last submission
+	u64 done; // Every ticket up to this one has completed
+} upload;
+
+static void mk_upload(struct dev dev)
 {
-	errno = 0;
-	strncpy(filename, "font.pbm", 8 + 1);
-	FILE *file = fopen(root_path, "rb");
-	if (errno) {
-		fprintf(
-			stderr,
-			"Error opening file at path \"%s\"\n",
-			root_path
-		);
+	VkResult err;
+	int own = dev.xfer_ind != dev.q_ind;
+
+	upload = (struct upload) {
+		.dev = dev.log,
+		.props_mem = dev.props_mem,
+		.atom = dev.props.limits.nonCoherentAtomSize,
+		.xfer = dev.xfer,
+		.q = dev.q,
+		.xfer_ind = dev.xfer_ind,
+		.q_ind = dev.q_ind,
+		.next = 1,
+	};
 
-		panic();
-	}
+	VkCommandPoolCreateFlags flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+		| VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	upload.pool = mk_pool(dev, dev.xfer_ind, flags);
+	if (own) upload.acquire_pool = mk_pool(dev, dev.q_ind, flags);
 
-	/* Header */
+	if (dev.timeline) {
+		VkSemaphoreTypeCreateInfoKHR type_info = {
+		STYPE(SEMAPHORE_TYPE_CREATE_INFO_KHR)
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+			.initialValue = 0,
+			.pNext = NULL,
+		};
 
-	#define HEAD_LEN 11
-	char head[HEAD_LEN], *ptr = head;
+		VkSemaphoreCreateInfo sem_create_info = {
+		STYPE(SEMAPHORE_CREATE_INFO)
+			.flags = 0,
+			.pNext = &type_info,
+		};
 
-	clearerr(file);
-	fread(head, 1, HEAD_LEN, file);
-	if (ferror(file)) {
-		fprintf(
-			stderr,
-			"Error reading file \"%s\" header\n",
-			root_path
+		err = vkCreateSemaphore(
+			dev.log,
+			&sem_create_info,
+			NULL,
+			&upload.timeline
 		);
-		panic();
-	}
 
-	if (strncmp(ptr, "P4", 2)) {
-		fprintf(
-			stderr,
-			"Invalid header in file \"%s\": "
-			"not a PBM file (\"%.2s\")\n",
-			root_path,
-			head
-		);
-		panic();
-	}
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to create timeline semaphore");
+		}
 
-	ptr += 3;
-	if (strncmp(ptr, "128 128", 7)) {
-		fprintf(
-			stderr,
-			"Invalid header in file \"%s\": "
-			"not a 128-pixel square image\n",
-			root_path
-		);
-		panic();
-	}
+		upload.counter = (PFN_vkGetSemaphoreCounterValueKHR)
+			vkGetDeviceProcAddr(
+				dev.log,
+				"vkGetSemaphoreCounterValueKHR"
+			);
 
-	ptr += 7;
-	if (*ptr != '\n') {
-		fprintf(stderr, "Invalid header in file \"%s\"\n", root_path);
-		panic();
+		upload.wait = (PFN_vkWaitSemaphoresKHR)
+			vkGetDeviceProcAddr(dev.log, "vkWaitSemaphoresKHR");
 	}
 
-	#undef HEAD_LEN
+	for (u32 i = 0; i < UPLOAD_BATCHES; ++i) {
+		struct batch *batch = upload.q + i;
 
-	/* Data */
+		VkCommandBufferAllocateInfo cmd_alloc_info = {
+		STYPE(COMMAND_BUFFER_ALLOCATE_INFO)
+			.commandPool = upload.pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+			.pNext = NULL,
+		};
 
-	unsigned char *raw = malloc(FONT_SIZE / 8);
-	unsigned char *exp = malloc(FONT_SIZE);
-	assert(raw);
-	assert(exp);
+		err = vkAllocateCommandBuffers(dev.log, &cmd_alloc_info, &batch->cmd);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to allocate upload command buffer");
+		}
 
-	clearerr(file);
-	fread(raw, 1, FONT_SIZE / 8, file);
-	if (ferror(file)) {
-		fprintf(
-			stderr,
-			"Error reading file \"%s\" data\n",
-			root_path
-		);
-		panic();
-	}
+		if (own) {
+			cmd_alloc_info.commandPool = upload.acquire_pool;
+			err = vkAllocateCommandBuffers(
+				dev.log,
+				&cmd_alloc_info,
+				&batch->acquire
+			);
 
-	for (size_t i = 0; i < FONT_SIZE / 8; ++i) {
-		size_t j = 8;
-		while (j --> 0) {
-			exp[8 * i + j] = 255 * (0 != (raw[i] & (1 << (7 - j))));
+			if (err != VK_SUCCESS) {
+				panic_msg("unable to allocate upload command buffer");
+			}
 		}
-	}
 
-	fclose(file);
-	free(raw);
+		if (upload.timeline) continue;
 
-	printf("Read %u bytes from \"%s\"\n", FONT_SIZE / 8, root_path);
-	return exp;
+		VkSemaphoreCreateInfo sem_create_info = {
+		STYPE(SEMAPHORE_CREATE_INFO)
+			.flags = 0,
+			.pNext = NULL,
+		};
+
+		VkFenceCreateInfo fence_create_info = {
+		STYPE(FENCE_CREATE_INFO)
+			.flags = 0,
+			.pNext = NULL,
+		};
+
+		err = vkCreateFence(dev.log, &fence_create_info, NULL, &batch->fence);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to create upload fence");
+		}
+
+		if (!own) continue;
+
+		err = vkCreateSemaphore(dev.log, &sem_create_info, NULL, &batch->sem);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to create upload semaphore");
+		}
+	}
+
+	printf(
+		"Created upload service (%u batches, %s, %s)\n",
+		UPLOAD_BATCHES,
+		own ? "ownership transfer" : "shared queue",
+		upload.timeline ? "timeline" : "fences"
+	);
 }
 
-static struct font load_font(struct dev dev, VkCommandPool pool)
+static int upload_complete(struct batch *batch)
 {
-	/* Staging buffer */
+	if (upload.timeline) {
+		u64 value;
+		upload.counter(upload.dev, upload.timeline, &value);
+		return value >= batch->ticket;
+	}
 
-	VkResult err;
-	struct ak_buf staging;
-	void *src;
+	return VK_SUCCESS == vkGetFenceStatus(upload.dev, batch->fence);
+}
 
-	AK_BUF_MK_AND_MAP(
-		dev.log,
-		dev.props_mem,
-		"font staging",
-		FONT_SIZE,
-		TRANSFER_SRC,
-		&staging,
-		&src
-	);
+// With all set, the caller guarantees the device is idle
+static void upload_collect(int all)
+{
+	for (u32 i = 0; i < UPLOAD_BATCHES; ++i) {
+		struct batch *batch = upload.q + i;
+		if (!batch->ticket) continue;
+		if (!all && !upload_complete(batch)) continue;
 
-	unsigned char *font = read_font();
-	memcpy(src, font, FONT_SIZE);
-	printf("Copied font to device\n");
-	free(font);
+		for (u32 j = 0; j < batch->staging_n; ++j)
+			ak_buf_free(upload.dev, batch->staging[j]);
 
-	/* Texture */
+		if (batch->ticket > upload.done) upload.done = batch->ticket;
+		batch->staging_n = 0;
+		batch->ticket = 0;
+	}
+}
 
-	struct ak_img tex;
-	AK_IMG_MK(
-		dev.log,
-		dev.props_mem,
-		"font texture",
-		128, 128, 0,
-		VK_FORMAT_R8_UNORM,
-		AK_IMG_USAGE(SAMPLED) | AK_IMG_USAGE(TRANSFER_DST),
-		COLOR,
-		&tex
-	);
+// Ticket values are ordered; batches complete in submission order
+static int upload_done(u64 ticket)
+{
+	if (ticket > upload.done) upload_collect(0);
+	return ticket <= upload.done;
+}
 
-	VkSamplerCreateInfo sampler_create_info = {
-	STYPE(SAMPLER_CREATE_INFO)
-		.flags = 0,
-		.magFilter = VK_FILTER_NEAREST,
-		.minFilter = VK_FILTER_NEAREST,
-		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-		.mipLodBias = 0.f,
-		.anisotropyEnable = VK_FALSE,
-		.maxAnisotropy = 0.f,
-		.compareEnable = VK_FALSE,
-		.compareOp = VK_COMPARE_OP_NEVER,
-		.minLod = 0.f,
-		.maxLod = 0.f,
-		.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
-		.unnormalizedCoordinates = VK_FALSE,
+static struct batch *upload_open()
+{
+	VkResult err;
+	struct batch *batch = upload.q + upload.head;
+	if (batch->open) return batch;
+
+	// Out of batches; only stalls when uploads outpace the copy engine
+	if (batch->ticket) {
+		if (upload.timeline) {
+			VkSemaphoreWaitInfoKHR wait_info = {
+			STYPE(SEMAPHORE_WAIT_INFO_KHR)
+				.flags = 0,
+				.semaphoreCount = 1,
+				.pSemaphores = &upload.timeline,
+				.pValues = &batch->ticket,
+				.pNext = NULL,
+			};
+
+			upload.wait(upload.dev, &wait_info, UINT64_MAX);
+		} else vkWaitForFences(
+			upload.dev,
+			1,
+			&batch->fence,
+			VK_TRUE,
+			UINT64_MAX
+		);
+
+		upload_collect(0);
+	}
+
+	VkCommandBufferBeginInfo begin_info = {
+	STYPE(COMMAND_BUFFER_BEGIN_INFO)
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
 		.pNext = NULL,
 	};
 
-	VkSampler sampler;
-	err = vkCreateSampler(dev.log, &sampler_create_info, NULL, &sampler);
+	err = vkBeginCommandBuffer(batch->cmd, &begin_info);
 	if (err != VK_SUCCESS) {
-		panic_msg("unable to create unfiltered texture sampler\n");
+		panic_msg("unable to begin command buffer recording");
 	}
 
-	printf("Created unfiltered texture sampler\n");
+	if (batch->acquire) {
+		err = vkBeginCommandBuffer(batch->acquire, &begin_info);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to begin command buffer recording");
+		}
+	}
 
-	/* Transfer */
+	if (!upload.timeline) vkResetFences(upload.dev, 1, &batch->fence);
 
-	VkCommandBufferAllocateInfo cmd_alloc_info = {
-	STYPE(COMMAND_BUFFER_ALLOCATE_INFO)
-		.commandPool = pool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+	batch->stages = 0;
+	batch->open = 1;
+	return batch;
+}
+
+// Returns the ticket to poll with upload_done()
+static u64 upload_submit()
+{
+	VkResult err;
+	struct batch *batch = upload.q + upload.head;
+	if (!batch->open) return upload.last; // Nothing recorded
+
+	/* Flush host writes for non-coherent memory */
+
+	VkMappedMemoryRange ranges[UPLOAD_STAGING];
+	u32 range_count = 0;
+
+	for (u32 i = 0; i < batch->staging_n; ++i) {
+		struct ak_buf staging = batch->staging[i];
+		range_count += ak_buf_range(
+			staging,
+			upload.atom,
+			0,
+			staging.size,
+			ranges + range_count
+		);
+	}
+
+	if (range_count) {
+		err = vkFlushMappedMemoryRanges(upload.dev, range_count, ranges);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to flush mapped memory");
+		}
+	}
+
+	err = vkEndCommandBuffer(batch->cmd);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to end command buffer recording");
+	}
+
+	u64 ticket = upload.next++;
+	int own = !!batch->acquire;
+
+	/* With timelines, the transfer signals the value below the ticket
+	 * and the acquire signals the ticket; either way the ticket is the
+	 * value the batch is complete at
+	 */
+
+	u64 values[2] = { own ? 2 * ticket - 1 : 2 * ticket, 2 * ticket };
+	VkTimelineSemaphoreSubmitInfoKHR timeline_infos[2] = {
+		{
+		STYPE(TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR)
+			.waitSemaphoreValueCount = 0,
+			.pWaitSemaphoreValues = NULL,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = values,
+			.pNext = NULL,
+		}, {
+		STYPE(TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR)
+			.waitSemaphoreValueCount = 1,
+			.pWaitSemaphoreValues = values,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = values + 1,
+			.pNext = NULL,
+		}
+	};
+
+	VkSemaphore handoff = upload.timeline ?: batch->sem;
+	VkSubmitInfo submit_info = {
+	STYPE(SUBMIT_INFO)
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
 		.commandBufferCount = 1,
-		.pNext = NULL,
+		.pCommandBuffers = &batch->cmd,
+		.signalSemaphoreCount = upload.timeline || own ? 1 : 0,
+		.pSignalSemaphores = &handoff,
+		.pNext = upload.timeline ? timeline_infos : NULL,
 	};
 
-	VkCommandBuffer cmd;
-	err = vkAllocateCommandBuffers(dev.log, &cmd_alloc_info, &cmd);
+	err = vkQueueSubmit(
+		upload.xfer,
+		1,
+		&submit_info,
+		own ? VK_NULL_HANDLE : batch->fence
+	);
+
 	if (err != VK_SUCCESS) {
-		panic_msg("unable to allocate command buffer\n");
+		panic_msg("unable to submit upload");
 	}
 
-	printf("Allocated transfer command buffer\n");
+	if (own) {
+		err = vkEndCommandBuffer(batch->acquire);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to end command buffer recording");
+		}
 
-	VkCommandBufferBeginInfo begin_info = {
-	STYPE(COMMAND_BUFFER_BEGIN_INFO)
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-		.pInheritanceInfo = NULL,
+		VkPipelineStageFlags stages = batch->stages
+			?: VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquire_info = {
+		STYPE(SUBMIT_INFO)
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &handoff,
+			.pWaitDstStageMask = &stages,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch->acquire,
+			.signalSemaphoreCount = upload.timeline ? 1 : 0,
+			.pSignalSemaphores = &upload.timeline,
+			.pNext = upload.timeline ? timeline_infos + 1 : NULL,
+		};
+
+		err = vkQueueSubmit(upload.q, 1, &acquire_info, batch->fence);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to submit upload acquire");
+		}
+	}
+
+	batch->ticket = upload.timeline ? 2 * ticket : ticket;
+	batch->open = 0;
+	upload.head = (upload.head + 1) % UPLOAD_BATCHES;
+	upload.last = batch->ticket;
+
+	return batch->ticket;
+}
+
+// Returns a mapped staging buffer owned by the open batch
+static void *upload_stage(VkDeviceSize size, VkBuffer *out)
+{
+	if (upload.q[upload.head].staging_n == UPLOAD_STAGING) upload_submit();
+	struct batch *batch = upload_open();
+	struct ak_buf *staging = batch->staging + batch->staging_n++;
+
+	void *mapped;
+	AK_BUF_MK_AND_MAP(
+		upload.dev,
+		upload.props_mem,
+		"upload staging",
+		size,
+		TRANSFER_SRC,
+		staging,
+		&mapped
+	);
+
+	*out = staging->buf;
+	return mapped;
+}
+
+/* Hands a resource written by the open batch to the graphics queue;
+ * the barriers carry TRANSFER_WRITE as their source access
+ */
+
+static void upload_hand(
+	VkBufferMemoryBarrier *buf,
+	VkImageMemoryBarrier *img,
+	VkAccessFlags dst_access,
+	VkPipelineStageFlags dst_stage
+) {
+	struct batch *batch = upload.q + upload.head;
+	assert(batch->open);
+
+	if (!batch->acquire) { // Same queue
+		if (buf) buf->dstAccessMask = dst_access;
+		if (img) img->dstAccessMask = dst_access;
+
+		vkCmdPipelineBarrier(
+			batch->cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			dst_stage,
+			0,
+			0, NULL,
+			buf ? 1 : 0, buf,
+			img ? 1 : 0, img
+		);
+
+		return;
+	}
+
+	// Release; the destination scope is ignored
+	if (buf) {
+		buf->dstAccessMask = 0;
+		buf->srcQueueFamilyIndex = upload.xfer_ind;
+		buf->dstQueueFamilyIndex = upload.q_ind;
+	}
+
+	if (img) {
+		img->dstAccessMask = 0;
+		img->srcQueueFamilyIndex = upload.xfer_ind;
+		img->dstQueueFamilyIndex = upload.q_ind;
+	}
+
+	vkCmdPipelineBarrier(
+		batch->cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, NULL,
+		buf ? 1 : 0, buf,
+		img ? 1 : 0, img
+	);
+
+	// Acquire; chained to the semaphore wait on the same stages
+	if (buf) {
+		buf->srcAccessMask = 0;
+		buf->dstAccessMask = dst_access;
+	}
+
+	if (img) {
+		img->srcAccessMask = 0;
+		img->dstAccessMask = dst_access;
+	}
+
+	vkCmdPipelineBarrier(
+		batch->acquire,
+		dst_stage,
+		dst_stage,
+		0,
+		0, NULL,
+		buf ? 1 : 0, buf,
+		img ? 1 : 0, img
+	);
+
+	batch->stages |= dst_stage;
+}
+
+static void upload_buf(
+	struct ak_buf dst,
+	VkDeviceSize off,
+	VkBuffer src,
+	VkDeviceSize size,
+	VkAccessFlags dst_access,
+	VkPipelineStageFlags dst_stage
+) {
+	struct batch *batch = upload_open();
+
+	VkBufferCopy region = { 0, off, size };
+	vkCmdCopyBuffer(batch->cmd, src, dst.buf, 1, &region);
+
+	VkBufferMemoryBarrier barrier = {
+	STYPE(BUFFER_MEMORY_BARRIER)
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = dst.buf,
+		.offset = off,
+		.size = size,
 		.pNext = NULL,
 	};
 
-	err = vkBeginCommandBuffer(cmd, &begin_info);
-	if (err != VK_SUCCESS) {
-		panic_msg("unable to begin command buffer recording");
-	}
+	upload_hand(&barrier, NULL, dst_access, dst_stage);
+}
+
+// Whole mip levels, left in SHADER_READ_ONLY_OPTIMAL
+static void upload_img(
+	struct ak_img dst,
+	u32 levels,
+	VkBuffer src,
+	const VkBufferImageCopy *regions,
+	VkPipelineStageFlags dst_stage
+) {
+	struct batch *batch = upload_open();
 
-	VkImageMemoryBarrier tex_prep_barrier = {
+	VkImageMemoryBarrier barrier = {
 	STYPE(IMAGE_MEMORY_BARRIER)
 		.srcAccessMask = 0,
 		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
@@ -851,11 +2258,11 @@ static struct font load_font(struct dev dev, VkCommandPool pool)
 		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.image = tex.img,
+		.image = dst.img,
 		.subresourceRange = {
 			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 			.baseMipLevel = 0,
-			.levelCount = 1,
+			.levelCount = levels,
 			.baseArrayLayer = 0,
 			.layerCount = 1,
 		},
@@ -863,155 +2270,738 @@ static struct font load_font(struct dev dev, VkCommandPool pool)
 	};
 
 	vkCmdPipelineBarrier(
-		cmd,
+		batch->cmd,
 		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
 		0,
 		0, NULL,
 		0, NULL,
-		1, &tex_prep_barrier
+		1, &barrier
 	);
 
-	VkBufferImageCopy dev_region = {
-		.bufferOffset = 0,
-		.bufferRowLength = 0,
-		.bufferImageHeight = 0,
-		.imageSubresource = {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		},
-		.imageOffset = { 0, 0, 0 },
-		.imageExtent = { 128, 128, 1 },
+	vkCmdCopyBufferToImage(
+		batch->cmd,
+		src,
+		dst.img,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		levels,
+		regions
+	);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	upload_hand(NULL, &barrier, VK_ACCESS_SHADER_READ_BIT, dst_stage);
+}
+
+static void upload_free()
+{
+	upload_collect(1);
+
+	for (u32 i = 0; i < UPLOAD_BATCHES; ++i) {
+		vkDestroySemaphore(upload.dev, upload.q[i].sem, NULL);
+		vkDestroyFence(upload.dev, upload.q[i].fence, NULL);
+	}
+
+	vkDestroySemaphore(upload.dev, upload.timeline, NULL);
+	vkDestroyCommandPool(upload.dev, upload.pool, NULL);
+	vkDestroyCommandPool(upload.dev, upload.acquire_pool, NULL);
+}
+
+#define GLYPH_COUNT (FONT_OFF * FONT_OFF)
+
+// Down to a texel per glyph
+static u32 font_mip_levels(u32 width)
+{
+	return __builtin_ctz(width / FONT_OFF) + 1;
+}
+
+static size_t font_mip_size(u32 width, u32 levels)
+{
+	size_t size = 0;
+	for (u32 l = 0; l < levels; ++l)
+		size += ((size_t)width * width) >> (2 * l);
+	return size;
+}
+
+struct glyph { // Tight bounds within a font cell; mirrored in char.glsl
+	v2 lo; // In cell units, y down
+	v2 hi; // Equal to lo (zero) if the glyph is empty
+};
+
+static unsigned char *read_font(struct glyph *glyphs) // Read custom PBM file
+{
+	errno = 0;
+	strncpy(filename, "font.pbm", 8 + 1);
+	FILE *file = fopen(root_path, "rb");
+	if (errno) {
+		fprintf(
+			stderr,
+			"Error opening file at path \"%s\"\n",
+			root_path
+		);
+
+		panic();
+	}
+
+	/* Header */
+
+	#define HEAD_LEN 11
+	char head[HEAD_LEN], *ptr = head;
+
+	clearerr(file);
+	fread(head, 1, HEAD_LEN, file);
+	if (ferror(file)) {
+		fprintf(
+			stderr,
+			"Error reading file \"%s\" header\n",
+			root_path
+		);
+		panic();
+	}
+
+	if (strncmp(ptr, "P4", 2)) {
+		fprintf(
+			stderr,
+			"Invalid header in file \"%s\": "
+			"not a PBM file (\"%.2s\")\n",
+			root_path,
+			head
+		);
+		panic();
+	}
+
+	ptr += 3;
+	if (strncmp(ptr, "128 128", 7)) {
+		fprintf(
+			stderr,
+			"Invalid header in file \"%s\": "
+			"not a 128-pixel square image\n",
+			root_path
+		);
+		panic();
+	}
+
+	ptr += 7;
+	if (*ptr != '\n') {
+		fprintf(stderr, "Invalid header in file \"%s\"\n", root_path);
+		panic();
+	}
+
+	#undef HEAD_LEN
+
+	/* Data */
+
+	unsigned char *raw = malloc(FONT_SIZE / 8);
+	unsigned char *exp = malloc(FONT_SIZE);
+	assert(raw);
+	assert(exp);
+
+	clearerr(file);
+	fread(raw, 1, FONT_SIZE / 8, file);
+	if (ferror(file)) {
+		fprintf(
+			stderr,
+			"Error reading file \"%s\" data\n",
+			root_path
+		);
+		panic();
+	}
+
+	for (size_t i = 0; i < FONT_SIZE / 8; ++i) {
+		size_t j = 8;
+		while (j --> 0) {
+			exp[8 * i + j] = 255 * (0 != (raw[i] & (1 << (7 - j))));
+		}
+	}
+
+	fclose(file);
+	free(raw);
+
+	printf("Read %u bytes from \"%s\"\n", FONT_SIZE / 8, root_path);
+
+	/* Metrics */
+
+	u32 empty = 0;
+	for (u32 c = 0; c < GLYPH_COUNT; ++c) {
+		size_t x0 = (c % FONT_OFF) * CHAR_WIDTH;
+		size_t y0 = (c / FONT_OFF) * CHAR_WIDTH;
+		int lo_x = CHAR_WIDTH, lo_y = CHAR_WIDTH, hi_x = -1, hi_y = -1;
+
+		for (int y = 0; y < CHAR_WIDTH; ++y) {
+			for (int x = 0; x < CHAR_WIDTH; ++x) {
+				if (!exp[(y0 + y) * FONT_WIDTH + x0 + x]) continue;
+				lo_x = x < lo_x ? x : lo_x;
+				lo_y = y < lo_y ? y : lo_y;
+				hi_x = x > hi_x ? x : hi_x;
+				hi_y = y > hi_y ? y : hi_y;
+			}
+		}
+
+		if (hi_x < 0) {
+			glyphs[c] = (struct glyph) { V2_ZERO, V2_ZERO };
+			++empty;
+			continue;
+		}
+
+		glyphs[c] = (struct glyph) {
+			.lo = { lo_x * PIX_WIDTH, lo_y * PIX_WIDTH },
+			.hi = { (hi_x + 1) * PIX_WIDTH, (hi_y + 1) * PIX_WIDTH },
+		};
+	}
+
+	printf("Measured %u glyphs (%u empty)\n", GLYPH_COUNT, empty);
+	return exp;
+}
+
+/* Box-filtered mip chain, appended in place after the base level;
+ * cells stay aligned, so no level is generated from neighbouring glyphs.
+ * Filtered sampling would still cross cells; text.frag clamps to them
+ */
+static void font_mips(unsigned char *font, u32 width, u32 levels)
+{
+	const unsigned char *prev = font;
+	size_t w = width;
+
+	for (u32 l = 1; l < levels; ++l) {
+		unsigned char *next = (unsigned char*)prev + w * w;
+		w /= 2;
+
+		for (size_t y = 0; y < w; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				const unsigned char *p = prev + 2 * (y * 2 * w + x);
+				unsigned sum = p[0] + p[1] + p[2 * w] + p[2 * w + 1];
+				next[y * w + x] = (sum + 2) / 4;
+			}
+		}
+
+		prev = next;
+	}
+}
+
+/* Signed distance to the nearest glyph edge, SDF_SCALE samples per texel;
+ * computed per cell, so glyphs never bleed into each other
+ */
+static void font_sdf(unsigned char *field, const unsigned char *font)
+{
+	const u32 w = FONT_WIDTH * SDF_SCALE;
+	const float far = CHAR_WIDTH * CHAR_WIDTH * 2.f; // Squared cell diagonal
+
+	for (u32 c = 0; c < GLYPH_COUNT; ++c) {
+		u32 x0 = (c % FONT_OFF) * CHAR_WIDTH;
+		u32 y0 = (c / FONT_OFF) * CHAR_WIDTH;
+		const unsigned char *cell = font + y0 * FONT_WIDTH + x0;
+
+		for (u32 sy = 0; sy < CHAR_WIDTH * SDF_SCALE; ++sy)
+		for (u32 sx = 0; sx < CHAR_WIDTH * SDF_SCALE; ++sx) {
+			// Sample center, in cell texels
+			float px = (sx + .5f) / SDF_SCALE;
+			float py = (sy + .5f) / SDF_SCALE;
+			int in = 0 != cell[(u32)py * FONT_WIDTH + (u32)px];
+
+			// Treat everything outside the cell as empty
+			float edge = minf(
+				minf(px, CHAR_WIDTH - px),
+				minf(py, CHAR_WIDTH - py)
+			);
+
+			float d2 = in ? edge * edge : far;
+
+			for (u32 ty = 0; ty < CHAR_WIDTH; ++ty)
+			for (u32 tx = 0; tx < CHAR_WIDTH; ++tx) {
+				if (in == (0 != cell[ty * FONT_WIDTH + tx]))
+					continue;
+
+				// To the nearest point on the texel's square
+				float dx = maxf(maxf(tx - px, px - (tx + 1)), 0.f);
+				float dy = maxf(maxf(ty - py, py - (ty + 1)), 0.f);
+				d2 = minf(d2, dx * dx + dy * dy);
+			}
+
+			float d = sqrtf(d2) * (in ? 1.f : -1.f); // Positive inside
+			float v = minf(maxf(.5f + .5f * d / SDF_SPREAD, 0.f), 1.f);
+
+			u32 fx = x0 * SDF_SCALE + sx;
+			u32 fy = y0 * SDF_SCALE + sy;
+			field[fy * w + fx] = (unsigned char)(255.f * v + .5f);
+		}
+	}
+}
+
+static struct font load_font(struct dev dev, int sdf)
+{
+	/* Staging buffers */
+
+	VkResult err;
+	VkBuffer staging, metrics_staging;
+
+	const u32 width = sdf ? FONT_WIDTH * SDF_SCALE : FONT_WIDTH;
+	const u32 levels = font_mip_levels(width);
+	size_t size = font_mip_size(width, levels);
+	size_t metrics_size = GLYPH_COUNT * sizeof(struct glyph);
+
+	void *src = upload_stage(size, &staging);
+	struct glyph *glyphs = upload_stage(metrics_size, &metrics_staging);
+
+	unsigned char *font = read_font(glyphs);
+	unsigned char *tex_data = malloc(size); // See font_mips()
+	assert(tex_data);
+
+	if (sdf) {
+		font_sdf(tex_data, font);
+		printf("Generated %ux%u distance field\n", width, width);
+	} else memcpy(tex_data, font, FONT_SIZE);
+
+	font_mips(tex_data, width, levels);
+	memcpy(src, tex_data, size);
+	printf("Copied font (%u levels) to staging\n", levels);
+	free(tex_data);
+	free(font);
+
+	/* Metrics */
+
+	struct ak_buf metrics;
+	AK_BUF_HEAD("font metrics", metrics_size);
+	ak_buf_mk(
+		dev.log,
+		dev.props_mem,
+		metrics_size,
+		AK_BUF_USAGE(UNIFORM_BUFFER) | AK_BUF_USAGE(TRANSFER_DST),
+		AK_MEM_PROP(DEVICE_LOCAL),
+		&metrics
+	);
+
+	/* Texture */
+
+	struct ak_img tex;
+	AK_IMG_MK_MIPS(
+		dev.log,
+		dev.props_mem,
+		"font texture",
+		width, width, levels,
+		VK_FORMAT_R8_UNORM,
+		AK_IMG_USAGE(SAMPLED) | AK_IMG_USAGE(TRANSFER_DST),
+		COLOR,
+		&tex
+	);
+
+	VkSamplerCreateInfo sampler_create_info = {
+	STYPE(SAMPLER_CREATE_INFO)
+		.flags = 0,
+		// Crisp pixels up close; distance fields stay crisp when filtered
+		.magFilter = sdf ? VK_FILTER_LINEAR : VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+		.mipLodBias = MIP_BIAS,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 0.f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_NEVER,
+		.minLod = 0.f,
+		.maxLod = levels - 1,
+		.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+		.unnormalizedCoordinates = VK_FALSE,
+		.pNext = NULL,
 	};
 
-	vkCmdCopyBufferToImage(
+	VkSampler sampler;
+	err = vkCreateSampler(dev.log, &sampler_create_info, NULL, &sampler);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to create font sampler\n");
+	}
+
+	printf("Created font sampler\n");
+
+	/* Transfer; the first frame is ordered after it on the device */
+
+	// Offsets stay multiples of 4, as transfer-only queues require
+	VkBufferImageCopy dev_regions[levels];
+	for (u32 l = 0, off = 0; l < levels; ++l) {
+		u32 w = width >> l;
+		dev_regions[l] = (VkBufferImageCopy) {
+			.bufferOffset = off,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = l,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { w, w, 1 },
+		};
+
+		off += w * w;
+	}
+
+	upload_img(
+		tex,
+		levels,
+		staging,
+		dev_regions,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	);
+
+	upload_buf(
+		metrics,
+		0,
+		metrics_staging,
+		metrics_size,
+		VK_ACCESS_UNIFORM_READ_BIT,
+		  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+		| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+
+	upload_submit();
+	printf("Submitted font upload\n");
+
+	return (struct font) {
+		tex,
+		sampler,
+		metrics,
+	};
+}
+
+static void prep_share(struct dev dev, u32 frames, struct buf *out)
+{
+	/* Could combine with the rchar buffer
+	 * as they are updated at the same rate;
+	 * however, this structure may
+	 * become larger in the future
+	 */
+
+	struct ak_buf buf;
+	u64 align = dev.props.limits.minUniformBufferOffsetAlignment;
+	u64 frame_size = ak_align_up(sizeof(struct txt_share), align);
+	u64 size = frame_size * frames;
+
+	AK_BUF_MK_AND_MAP(
+		dev.log,
+		dev.props_mem,
+		"share",
+		size,
+		UNIFORM_BUFFER,
+		&buf,
+		&out->mapped
+	);
+
+	out->gpu = buf;
+	memset(out->mapped, 0, sizeof(struct txt_share));
+	((struct txt_share*)out->mapped)->vp = M4_ID;
+	out->align = align;
+	out->frame_size = frame_size;
+	out->stride = sizeof(struct txt_share);
+}
+
+// Device-local memory the host can map at scale (ReBAR, UMA), as opposed to
+// the small BAR window most discrete GPUs expose
+static int host_local(VkPhysicalDeviceMemoryProperties props_mem)
+{
+	VkMemoryPropertyFlags mask = AK_MEM_PROP(DEVICE_LOCAL)
+		| AK_MEM_PROP(HOST_VISIBLE);
+
+	for (u32 i = 0; i < props_mem.memoryTypeCount; ++i) {
+		VkMemoryType t = props_mem.memoryTypes[i];
+		if (mask != (t.propertyFlags & mask)) continue;
+		if (props_mem.memoryHeaps[t.heapIndex].size > (256ull << 20))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void prep_rchar(
+	struct dev dev,
+	size_t stride,
+	size_t cap,
+	u32 retained,
+	u32 frames,
+	int local, // See txt_cfg.device_local
+	struct buf *out
+) {
+	struct ak_buf buf;
+	u64 align = dev.props.limits.minStorageBufferOffsetAlignment;
+	align = align > 64 ? align : 64; // Whole cache lines per frame
+
+	u64 tail = ak_align_up(cap * stride, align);
+	u64 frame_size = ak_align_up(tail + retained * stride, align);
+	u64 size = frame_size * frames;
+
+	out->local = (struct ak_buf) { 0 };
+	if (local && host_local(dev.props_mem)) {
+		AK_BUF_HEAD("char (host-mapped device-local)", size);
+		ak_buf_mk_pref(
+			dev.log,
+			dev.props_mem,
+			size,
+			AK_BUF_USAGE(STORAGE_BUFFER),
+			AK_MEM_PROP(DEVICE_LOCAL) | AK_MEM_PROP(HOST_VISIBLE),
+			AK_MEM_PROP(HOST_COHERENT),
+			&buf
+		);
+
+		out->mapped = buf.alloc.mapped;
+	} else if (local) {
+		// One staging frame per frame in flight, copied in run()
+		AK_BUF_MK_AND_MAP(
+			dev.log,
+			dev.props_mem,
+			"char staging",
+			size,
+			TRANSFER_SRC,
+			&buf,
+			&out->mapped
+		);
+
+		AK_BUF_HEAD("char (device-local)", size);
+		ak_buf_mk(
+			dev.log,
+			dev.props_mem,
+			size,
+			  AK_BUF_USAGE(STORAGE_BUFFER)
+			| AK_BUF_USAGE(TRANSFER_DST),
+			AK_MEM_PROP(DEVICE_LOCAL),
+			&out->local
+		);
+	} else {
+		AK_BUF_MK_AND_MAP(
+			dev.log,
+			dev.props_mem,
+			"char",
+			size,
+			STORAGE_BUFFER,
+			&buf,
+			&out->mapped
+		);
+	}
+
+	out->gpu = buf;
+	memset(out->mapped, 0, size);
+	out->align = align;
+	out->frame_size = frame_size;
+	out->tail = tail;
+	out->stride = stride;
+	out->cap = cap;
+}
+
+static struct stage mk_stage(struct dev dev, u32 frames)
+{
+	struct stage stage = { 0 };
+
+	// Re-recorded every frame
+	stage.pool = mk_pool(
+		dev,
+		dev.q_ind,
+		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+	);
+
+	VkCommandBufferAllocateInfo cmd_alloc_info = {
+	STYPE(COMMAND_BUFFER_ALLOCATE_INFO)
+		.commandPool = stage.pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = frames,
+		.pNext = NULL,
+	};
+
+	VkResult err = vkAllocateCommandBuffers(
+		dev.log,
+		&cmd_alloc_info,
+		stage.cmd
+	);
+
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to allocate staging command buffers\n");
+	}
+
+	// Device-local memory starts out undefined
+	for (u32 i = 0; i < frames; ++i) stage.full[i] = 1;
+
+	printf("Allocated %u staging command buffers\n", frames);
+	return stage;
+}
+
+// Copies what the host wrote this frame; submitted ahead of the draw
+static void record_stage(
+	VkCommandBuffer cmd,
+	struct buf rchar,
+	u32 slot,
+	size_t count,
+	struct range dirty,
+	int full
+) {
+	VkCommandBufferBeginInfo begin_info = {
+	STYPE(COMMAND_BUFFER_BEGIN_INFO)
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+		.pNext = NULL,
+	};
+
+	VkResult err = vkBeginCommandBuffer(cmd, &begin_info);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to begin command buffer recording");
+	}
+
+	VkDeviceSize base = slot * rchar.frame_size;
+	VkBufferCopy regions[2];
+	u32 region_count = 0;
+
+	if (full) {
+		regions[region_count++] = (VkBufferCopy) {
+			base,
+			base,
+			rchar.frame_size,
+		};
+	} else {
+		if (count) regions[region_count++] = (VkBufferCopy) {
+			base,
+			base,
+			count * rchar.stride,
+		};
+
+		VkDeviceSize off = base + rchar.tail + dirty.lo * rchar.stride;
+		if (dirty.hi > dirty.lo) regions[region_count++] = (VkBufferCopy) {
+			off,
+			off,
+			(dirty.hi - dirty.lo) * rchar.stride,
+		};
+	}
+
+	if (region_count) vkCmdCopyBuffer(
 		cmd,
-		staging.buf,
-		tex.img,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&dev_region
+		rchar.gpu.buf,
+		rchar.local.buf,
+		region_count,
+		regions
 	);
 
-	VkImageMemoryBarrier tex_swap_barrier = {
-	STYPE(IMAGE_MEMORY_BARRIER)
+	VkBufferMemoryBarrier barrier = {
+	STYPE(BUFFER_MEMORY_BARRIER)
 		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
 		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.image = tex.img,
-		.subresourceRange = {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		},
+		.buffer = rchar.local.buf,
+		.offset = base,
+		.size = rchar.frame_size,
 		.pNext = NULL,
 	};
 
 	vkCmdPipelineBarrier(
 		cmd,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 		0,
 		0, NULL,
-		0, NULL,
-		1, &tex_swap_barrier
+		1, &barrier,
+		0, NULL
 	);
 
 	err = vkEndCommandBuffer(cmd);
 	if (err != VK_SUCCESS) {
 		panic_msg("unable to end command buffer recording");
 	}
+}
 
-	VkSubmitInfo submit_info = {
-	STYPE(SUBMIT_INFO)
-		.waitSemaphoreCount = 0,
-		.pWaitSemaphores = NULL,
-		.pWaitDstStageMask = NULL,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &cmd,
-		.signalSemaphoreCount = 0,
-		.pSignalSemaphores = NULL,
-		.pNext = NULL,
-	};
-
-	vkQueueSubmit(dev.q, 1, &submit_info, NULL);
-	vkQueueWaitIdle(dev.q);
-	vkFreeCommandBuffers(dev.log, pool, 1, &cmd);
-	ak_buf_free(dev.log, staging);
+struct indirect { // Per frame in flight; mirrored in cull.comp
+	VkDrawIndirectCommand draw[2]; // Quads, retained quads
+	VkDispatchIndirectCommand cull[2];
+	u32 count[2]; // Submitted, read by the culling pre-pass
+};
 
-	return (struct font) {
-		tex,
-		sampler,
-	};
-}
+_Static_assert(
+	offsetof(struct indirect, count) == 56,
+	"indirect args must match the layout in cull.comp"
+);
 
-static void prep_share(struct dev dev, struct buf *out)
+static void prep_indirect(struct dev dev, u32 frames, struct buf *out)
 {
-	/* Could combine with the rchar buffer
-	 * as they are updated at the same rate;
-	 * however, this structure may
-	 * become larger in the future
+	/* Draw arguments are written by the host once per frame,
+	 * so the pre-recorded command buffers only ever draw
+	 * as many instances as were actually submitted;
+	 * one draw for the txt_buf, and one for the retained quads.
+	 * When culling, the pre-pass counts the instances instead.
 	 */
 
 	struct ak_buf buf;
-	u64 align = dev.props.limits.minUniformBufferOffsetAlignment;
-	u64 frame_size = ak_align_up(sizeof(struct txt_share), align);
-	u64 size = frame_size * SWAP_IMG_COUNT;
+	u64 align = dev.props.limits.minStorageBufferOffsetAlignment;
+	align = align > 4 ? align : 4; // Required by vkCmdDrawIndirect
+	u64 frame_size = ak_align_up(sizeof(struct indirect), align);
+	u64 size = frame_size * frames;
 
-	AK_BUF_MK_AND_MAP(
+	AK_BUF_HEAD("indirect", size);
+	ak_buf_mk_and_map(
 		dev.log,
 		dev.props_mem,
-		"share",
 		size,
-		UNIFORM_BUFFER,
+		AK_BUF_USAGE(INDIRECT_BUFFER) | AK_BUF_USAGE(STORAGE_BUFFER),
 		&buf,
 		&out->mapped
 	);
 
 	out->gpu = buf;
-	memset(out->mapped, 0, sizeof(struct txt_share));
-	((struct txt_share*)out->mapped)->vp = M4_ID;
+	memset(out->mapped, 0, size);
 	out->align = align;
 	out->frame_size = frame_size;
+	out->stride = sizeof(VkDrawIndirectCommand);
 }
 
-static void prep_rchar(struct dev dev, struct buf *out)
-{
+static void prep_list(
+	struct dev dev,
+	size_t cap,
+	u32 retained,
+	u32 frames,
+	struct buf *out
+) {
+	/* Indices of the quads that survive culling,
+	 * written and read on the device only
+	 */
+
 	struct ak_buf buf;
 	u64 align = dev.props.limits.minStorageBufferOffsetAlignment;
-	u64 frame_size = ak_align_up(MAX_QUAD * sizeof(struct raw_char), align);
-	u64 size = frame_size * SWAP_IMG_COUNT;
+	u64 tail = ak_align_up(cap * sizeof(u32), align);
+	u64 frame_size = ak_align_up(tail + retained * sizeof(u32), align);
+	u64 size = frame_size * frames;
 
-	AK_BUF_MK_AND_MAP(
+	AK_BUF_MK(
 		dev.log,
 		dev.props_mem,
-		"char",
+		"list",
 		size,
 		STORAGE_BUFFER,
-		&buf,
-		&out->mapped
+		AK_MEM_PROP(DEVICE_LOCAL),
+		&buf
 	);
 
 	out->gpu = buf;
-	memset(out->mapped, 0, size);
+	out->mapped = NULL;
 	out->align = align;
 	out->frame_size = frame_size;
+	out->tail = tail;
+	out->stride = sizeof(u32);
+	out->cap = cap;
 }
 
-static struct desc mk_desc_sets(VkDevice dev)
-{
+static struct desc mk_desc_sets(
+	VkDevice dev,
+	u32 frames,
+	int retained,
+	int cull
+) {
 	VkResult err;
 
-	// One UBO/SSBO per independent swap chain image
-	u32 set_count = 1 + 2 * SWAP_IMG_COUNT;
-	u32 lay_count = 3;
+	// One UBO/SSBO per frame in flight,
+	// plus an SSBO per frame for the retained quads;
+	// when culling, each text set also holds an index list,
+	// and the draw arguments get a set per frame
+	u32 text_count = (1 + !!retained) * frames;
+	u32 ssbo_count = (1 + !!cull) * text_count + !!cull * frames;
+	u32 set_count = 1 + frames + text_count + !!cull * frames;
+	u32 lay_count = 3 + !!cull;
 
 	/* Pool */
 
@@ -1025,10 +3015,10 @@ static struct desc mk_desc_sets(VkDevice dev)
 			.descriptorCount = 1,
 		}, {
 			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.descriptorCount = SWAP_IMG_COUNT,
+			.descriptorCount = frames + 1, // Plus font metrics
 		}, {
 			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-			.descriptorCount = SWAP_IMG_COUNT,
+			.descriptorCount = ssbo_count,
 		}
 	};
 
@@ -1052,7 +3042,8 @@ static struct desc mk_desc_sets(VkDevice dev)
 
 	/* Bindings */
 
-	VkDescriptorSetLayoutBinding bindings[4] = {
+	VkShaderStageFlags comp = cull ? VK_SHADER_STAGE_COMPUTE_BIT : 0;
+	VkDescriptorSetLayoutBinding bindings[7] = {
 		{ // Set 0 //
 			.binding = 0,
 			.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
@@ -1065,6 +3056,12 @@ static struct desc mk_desc_sets(VkDevice dev)
 			.descriptorCount = 1,
 			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
 			.pImmutableSamplers = NULL,
+		}, {
+			.binding = 2, // Glyph bounds
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | comp,
+			.pImmutableSamplers = NULL,
 		},
 
 		{ // Set 1 //
@@ -1072,7 +3069,8 @@ static struct desc mk_desc_sets(VkDevice dev)
 			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 			.descriptorCount = 1,
 			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
-			            | VK_SHADER_STAGE_FRAGMENT_BIT,
+			            | VK_SHADER_STAGE_FRAGMENT_BIT
+			            | comp,
 			.pImmutableSamplers = NULL,
 		},
 
@@ -1080,7 +3078,21 @@ static struct desc mk_desc_sets(VkDevice dev)
 			.binding = 0,
 			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			.descriptorCount = 1,
-			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | comp,
+			.pImmutableSamplers = NULL,
+		}, {
+			.binding = 1, // Index list, culling only
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | comp,
+			.pImmutableSamplers = NULL,
+		},
+
+		{ // Set 3 (culling only) //
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
 			.pImmutableSamplers = NULL,
 		}
 	};
@@ -1091,9 +3103,10 @@ static struct desc mk_desc_sets(VkDevice dev)
 	layouts = malloc(lay_count * sizeof(VkDescriptorSetLayout));
 	assert(layouts);
 
-	AK_MK_SET_LAYOUT(dev, "font",  bindings + 0, 2, layouts + 0);
-	AK_MK_SET_LAYOUT(dev, "share", bindings + 2, 1, layouts + 1);
-	AK_MK_SET_LAYOUT(dev, "text",  bindings + 3, 1, layouts + 2);
+	AK_MK_SET_LAYOUT(dev, "font",  bindings + 0, 3, layouts + 0);
+	AK_MK_SET_LAYOUT(dev, "share", bindings + 3, 1, layouts + 1);
+	AK_MK_SET_LAYOUT(dev, "text",  bindings + 4, 1 + !!cull, layouts + 2);
+	if (cull) AK_MK_SET_LAYOUT(dev, "args", bindings + 6, 1, layouts + 3);
 
 	VkDescriptorSetLayout *layouts_exp; // Expand layouts for the alloc call
 	layouts_exp = malloc(set_count * sizeof(VkDescriptorSetLayout));
@@ -1101,13 +3114,16 @@ static struct desc mk_desc_sets(VkDevice dev)
 	layouts_exp[0] = layouts[0];
 
 	layouts_exp[1] = layouts[1];
-	for (size_t i = 1; i < SWAP_IMG_COUNT; ++i)
+	for (size_t i = 1; i < frames; ++i)
 		layouts_exp[i + 1] = layouts_exp[i];
 
-	layouts_exp[1 + SWAP_IMG_COUNT] = layouts[2];
-	for (size_t i = 1 + SWAP_IMG_COUNT; i < set_count - 1; ++i)
+	layouts_exp[1 + frames] = layouts[2];
+	for (size_t i = 1 + frames; i < frames + text_count; ++i)
 		layouts_exp[i + 1] = layouts_exp[i];
 
+	for (size_t i = 1 + frames + text_count; i < set_count; ++i)
+		layouts_exp[i] = layouts[3];
+
 	VkDescriptorSetAllocateInfo desc_alloc_info = {
 	STYPE(DESCRIPTOR_SET_ALLOCATE_INFO)
 		.descriptorPool = pool,
@@ -1141,9 +3157,12 @@ static void mk_bindings(
 	struct desc desc,
 	struct font font,
 	struct buf share,
-	struct buf rchar
+	struct buf rchar,
+	u32 retained,
+	u32 frames
 ) {
-	size_t write_count = 2 + 2 * SWAP_IMG_COUNT;
+	size_t buf_count = (2 + !!retained) * frames;
+	size_t write_count = 3 + buf_count;
 	VkWriteDescriptorSet writes[write_count];
 
 	VkDescriptorImageInfo img_info = {
@@ -1178,10 +3197,10 @@ static void mk_bindings(
 		.pNext = NULL,
 	};
 
-	VkDescriptorBufferInfo buf_infos[2 * SWAP_IMG_COUNT];
-	size_t range = share.gpu.size / SWAP_IMG_COUNT;
+	VkDescriptorBufferInfo buf_infos[buf_count];
+	size_t range = share.frame_size;
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
+	for (size_t i = 0; i < frames; ++i) {
 		buf_infos[i] = (VkDescriptorBufferInfo) {
 			.buffer = share.gpu.buf,
 			.offset = i * range,
@@ -1202,35 +3221,149 @@ static void mk_bindings(
 		};
 	}
 
-	range = rchar.gpu.size / SWAP_IMG_COUNT;
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
-		buf_infos[SWAP_IMG_COUNT + i] = (VkDescriptorBufferInfo) {
-			.buffer = rchar.gpu.buf,
+	range = rchar.frame_size;
+	VkBuffer rchar_buf = rchar.local.buf ?: rchar.gpu.buf;
+
+	for (size_t i = 0; i < frames; ++i) {
+		buf_infos[frames + i] = (VkDescriptorBufferInfo) {
+			.buffer = rchar_buf,
 			.offset = i * range,
-			.range = range,
+			.range = rchar.tail,
+		};
+
+		writes[2 + frames + i] = (VkWriteDescriptorSet) {
+		STYPE(WRITE_DESCRIPTOR_SET)
+			.dstSet = desc.sets[1 + frames + i],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = buf_infos + frames + i,
+			.pTexelBufferView = NULL,
+			.pNext = NULL,
+		};
+	}
+
+	for (size_t i = 0; retained && i < frames; ++i) {
+		size_t j = 2 * frames + i;
+		buf_infos[j] = (VkDescriptorBufferInfo) {
+			.buffer = rchar_buf,
+			.offset = i * range + rchar.tail,
+			.range = retained * rchar.stride,
 		};
 
-		writes[2 + SWAP_IMG_COUNT + i] = (VkWriteDescriptorSet) {
+		writes[2 + j] = (VkWriteDescriptorSet) {
 		STYPE(WRITE_DESCRIPTOR_SET)
-			.dstSet = desc.sets[1 + SWAP_IMG_COUNT + i],
+			.dstSet = desc.sets[1 + j],
 			.dstBinding = 0,
 			.dstArrayElement = 0,
 			.descriptorCount = 1,
 			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			.pImageInfo = NULL,
-			.pBufferInfo = buf_infos + SWAP_IMG_COUNT + i,
+			.pBufferInfo = buf_infos + j,
 			.pTexelBufferView = NULL,
 			.pNext = NULL,
 		};
 	}
 
+	VkDescriptorBufferInfo metrics_info = {
+		.buffer = font.metrics.buf,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+
+	writes[2 + buf_count] = (VkWriteDescriptorSet) {
+	STYPE(WRITE_DESCRIPTOR_SET)
+		.dstSet = desc.sets[0],
+		.dstBinding = 2,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.pImageInfo = NULL,
+		.pBufferInfo = &metrics_info,
+		.pTexelBufferView = NULL,
+		.pNext = NULL,
+	};
+
 	vkUpdateDescriptorSets(dev, write_count, writes, 0, NULL);
 	printf("Updated descriptor sets (%zu writes)\n", write_count);
 }
 
+static void bind_cull(
+	VkDevice dev,
+	struct desc desc,
+	struct buf list,
+	struct buf indirect,
+	u32 retained,
+	u32 frames
+) {
+	size_t list_count = (1 + !!retained) * frames;
+	size_t write_count = list_count + frames;
+	VkWriteDescriptorSet writes[write_count];
+	VkDescriptorBufferInfo buf_infos[write_count];
+
+	// Second binding of each text set
+	for (size_t j = 0; j < list_count; ++j) {
+		size_t i = j % frames;
+		int tail = j >= frames; // Retained quads
+
+		buf_infos[j] = (VkDescriptorBufferInfo) {
+			.buffer = list.gpu.buf,
+			.offset = i * list.frame_size + tail * list.tail,
+			.range = tail ? retained * list.stride : list.tail,
+		};
+
+		writes[j] = (VkWriteDescriptorSet) {
+		STYPE(WRITE_DESCRIPTOR_SET)
+			.dstSet = desc.sets[1 + frames + j],
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = buf_infos + j,
+			.pTexelBufferView = NULL,
+			.pNext = NULL,
+		};
+	}
+
+	for (size_t i = 0; i < frames; ++i) {
+		size_t j = list_count + i;
+		buf_infos[j] = (VkDescriptorBufferInfo) {
+			.buffer = indirect.gpu.buf,
+			.offset = i * indirect.frame_size,
+			.range = sizeof(struct indirect),
+		};
+
+		writes[j] = (VkWriteDescriptorSet) {
+		STYPE(WRITE_DESCRIPTOR_SET)
+			.dstSet = desc.sets[1 + frames + j],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = buf_infos + j,
+			.pTexelBufferView = NULL,
+			.pNext = NULL,
+		};
+	}
+
+	vkUpdateDescriptorSets(dev, write_count, writes, 0, NULL);
+	printf("Updated culling descriptor sets (%zu writes)\n", write_count);
+}
+
 static struct graphics mk_graphics(
 	struct dev dev,
-	struct swap swap
+	struct swap swap,
+	int packed,
+	int direct,
+	int cull,
+	int coverage,
+	int sdf,
+	int scaled,
+	VkImageLayout final // Of the resolved image
 ) {
 	VkResult err;
 
@@ -1242,14 +3375,29 @@ static struct graphics mk_graphics(
 
 	/* Shader modules */
 
+	snprintf(
+		filename,
+		32,
+		"vert%s%s%s.spv",
+		packed ? "_packed" : direct ? "_direct" : "",
+		cull ? "_cull" : "",
 #ifdef PLATFORM_COMPAT_VBO
-	strncpy(filename, "vert_compat.spv", 15 + 1);
+		"_compat"
 #else
-	strncpy(filename, "vert.spv", 8 + 1);
+		""
 #endif
+	);
+
 	struct ak_shader vert = ak_shader_mk(dev.log, root_path);
 
-	strncpy(filename, "frag.spv", 8 + 1);
+	snprintf(
+		filename,
+		32,
+		"frag%s%s.spv",
+		sdf ? "_sdf" : "",
+		coverage ? "_coverage" : ""
+	);
+
 	struct ak_shader frag = ak_shader_mk(dev.log, root_path);
 
 	printf("Created shader modules (2)\n");
@@ -1372,20 +3520,24 @@ static struct graphics mk_graphics(
 	STYPE(PIPELINE_MULTISAMPLE_STATE_CREATE_INFO)
 		.flags = 0,
 		.rasterizationSamples = dev.sample_n,
-		.sampleShadingEnable = dev.feats.sampleRateShading,
+		.sampleShadingEnable = !coverage && dev.feats.sampleRateShading,
 		.minSampleShading = 1.f,
 		.pSampleMask = NULL,
-		.alphaToCoverageEnable = VK_FALSE,
+		.alphaToCoverageEnable = !!coverage,
 		.alphaToOneEnable = VK_FALSE,
 		.pNext = NULL,
 	};
 
+	// Distance fields blend their antialiased edges, unless resolved
+	int blend = sdf && !coverage;
+
 	template->depth_stencil_state_create_info
 	= (VkPipelineDepthStencilStateCreateInfo) {
 	STYPE(PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO)
 		.flags = 0,
 		.depthTestEnable = VK_TRUE,
-		.depthWriteEnable = VK_TRUE,
+		// Faint blended edges would otherwise occlude quads behind them
+		.depthWriteEnable = !blend,
 		.depthCompareOp = VK_COMPARE_OP_GREATER,
 		.depthBoundsTestEnable = VK_FALSE,
 		.stencilTestEnable = VK_FALSE,
@@ -1397,17 +3549,19 @@ static struct graphics mk_graphics(
 	};
 
 	template->blend_attach = (VkPipelineColorBlendAttachmentState) {
-		.blendEnable = VK_FALSE,
-		.srcColorBlendFactor = 0,
-		.dstColorBlendFactor = 0,
-		.colorBlendOp = 0,
+		.blendEnable = blend,
+		.srcColorBlendFactor = blend ? VK_BLEND_FACTOR_SRC_ALPHA : 0,
+		.dstColorBlendFactor = blend ?
+			VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : 0,
+		.colorBlendOp = VK_BLEND_OP_ADD,
 		.srcAlphaBlendFactor = 0,
 		.dstAlphaBlendFactor = 0,
 		.alphaBlendOp = 0,
 		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
 		                | VK_COLOR_COMPONENT_G_BIT
 		                | VK_COLOR_COMPONENT_B_BIT
-		                | VK_COLOR_COMPONENT_A_BIT,
+		                // Alpha carries coverage; keep the opaque clear
+		                | (coverage || sdf ? 0 : VK_COLOR_COMPONENT_A_BIT),
 	};
 
 	template->blend_state_create_info
@@ -1422,6 +3576,9 @@ static struct graphics mk_graphics(
 		.pNext = NULL,
 	};
 
+	// Single-sampled passes render straight to the target, unresolved
+	int multi = dev.sample_n > 1;
+
 	VkAttachmentDescription attach_col = {
 		.format = swap.format,
 		.samples = dev.sample_n,
@@ -1447,16 +3604,22 @@ static struct graphics mk_graphics(
 	VkAttachmentDescription attach_resolve = {
 		.format = swap.format,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.loadOp = multi ?
+			  VK_ATTACHMENT_LOAD_OP_DONT_CARE
+			: VK_ATTACHMENT_LOAD_OP_CLEAR,
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		.finalLayout = final,
 	};
 
+	/* Ordered resolve, depth, color (see mk_fbuffers()),
+	 * so that the single-sampled pass just drops the last
+	 */
+
 	VkAttachmentReference attach_col_ref = {
-		.attachment = 0,
+		.attachment = multi ? 2 : 0,
 		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 	};
 
@@ -1466,7 +3629,7 @@ static struct graphics mk_graphics(
 	};
 
 	VkAttachmentReference attach_resolve_ref = {
-		.attachment = 2,
+		.attachment = 0,
 		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 	};
 
@@ -1477,27 +3640,59 @@ static struct graphics mk_graphics(
 		.pInputAttachments = NULL,
 		.colorAttachmentCount = 1,
 		.pColorAttachments = &attach_col_ref,
-		.pResolveAttachments = &attach_resolve_ref,
+		.pResolveAttachments = multi ? &attach_resolve_ref : NULL,
 		.pDepthStencilAttachment = &attach_depth_ref,
 		.preserveAttachmentCount = 0,
 		.pPreserveAttachments = NULL,
 	};
 
 	VkAttachmentDescription attach[] = {
-		attach_col,
-		attach_depth,
 		attach_resolve,
+		attach_depth,
+		attach_col,
 	};
 
+	/* With several frames in flight, the multisampled color
+	 * and depth targets are shared between overlapping frames;
+	 * the swapchain image is also only ready once the acquire
+	 * semaphore (waited at color output) has been signaled.
+	 * A scaled scene target is also read by the last frame's upscale,
+	 * and by this frame's once the resolve (or color) writes land
+	 */
+
+	VkSubpassDependency deps[2] = {
+	{
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		              | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+		              | (scaled ? VK_PIPELINE_STAGE_TRANSFER_BIT : 0),
+		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		              | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		               | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		               | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dependencyFlags = 0,
+	}, {
+		.srcSubpass = 0,
+		.dstSubpass = VK_SUBPASS_EXTERNAL,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.dependencyFlags = 0,
+	}};
+
 	VkRenderPassCreateInfo pass_create_info = {
 	STYPE(RENDER_PASS_CREATE_INFO)
 		.flags = 0,
-		.attachmentCount = 3,
+		.attachmentCount = multi ? 3 : 2,
 		.pAttachments = attach,
 		.subpassCount = 1,
 		.pSubpasses = &subpass,
-		.dependencyCount = 0,
-		.pDependencies = NULL,
+		.dependencyCount = scaled ? 2 : 1,
+		.pDependencies = deps,
 		.pNext = NULL,
 	};
 
@@ -1509,6 +3704,19 @@ static struct graphics mk_graphics(
 
 	printf("Created render pass\n");
 
+	// Set per command buffer, for the render scale
+	template->dyn[0] = VK_DYNAMIC_STATE_VIEWPORT;
+	template->dyn[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+	template->dyn_state_create_info
+	= (VkPipelineDynamicStateCreateInfo) {
+	STYPE(PIPELINE_DYNAMIC_STATE_CREATE_INFO)
+		.flags = 0,
+		.dynamicStateCount = 2,
+		.pDynamicStates = template->dyn,
+		.pNext = NULL,
+	};
+
 	template->data = (VkGraphicsPipelineCreateInfo) {
 	STYPE(GRAPHICS_PIPELINE_CREATE_INFO)
 		.flags = 0,
@@ -1526,7 +3734,7 @@ static struct graphics mk_graphics(
 		.pMultisampleState = &template->multi_state_create_info,
 		.pDepthStencilState = &template->depth_stencil_state_create_info,
 		.pColorBlendState = &template->blend_state_create_info,
-		.pDynamicState = NULL,
+		.pDynamicState = &template->dyn_state_create_info,
 		/* .layout */
 		.renderPass = pass,
 		.subpass = 0,
@@ -1548,36 +3756,217 @@ static struct graphics mk_graphics(
 	};
 }
 
-static struct pipeline mk_pipe(
+/* Pipeline cache;
+ * persisted in the asset path behind a header naming the device and driver,
+ * so that a stale or foreign file is dropped instead of handed to the driver
+ */
+
+#define CACHE_MAGIC 0x43515854u // "TXQC"
+
+struct cache_head {
+	u32 magic;
+	u32 driver; // VkPhysicalDeviceProperties.driverVersion
+	u8 uuid[VK_UUID_SIZE]; // pipelineCacheUUID
+	u64 size; // Of the cache data that follows
+};
+
+static int cache_valid(struct dev dev, struct cache_head head)
+{
+	return head.magic == CACHE_MAGIC
+		&& head.driver == dev.props.driverVersion
+		&& !memcmp(head.uuid, dev.props.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Bytes between the current position and the end of the file
+static u64 cache_left(FILE *file)
+{
+	long pos = ftell(file);
+	if (pos < 0 || fseek(file, 0, SEEK_END)) return 0;
+
+	long end = ftell(file);
+	if (end < pos || fseek(file, pos, SEEK_SET)) return 0;
+	return end - pos;
+}
+
+// Sets warm if seeded from a valid file
+static VkPipelineCache mk_cache(struct dev dev, int *warm)
+{
+	strncpy(filename, "pipeline.cache", 14 + 1);
+	void *data = NULL;
+	struct cache_head head = { 0 };
+	*warm = 0;
+
+	FILE *file = fopen(root_path, "rb");
+	if (!file) {
+		printf("No pipeline cache at \"%s\"\n", root_path);
+	} else if (1 != fread(&head, sizeof(head), 1, file)) {
+		printf("Warning: pipeline cache header unreadable\n");
+	} else if (!cache_valid(dev, head)) {
+		printf("Pipeline cache is for another device or driver\n");
+	} else if (head.size > cache_left(file)) { // Corrupt size, or cut off
+		printf("Warning: pipeline cache truncated\n");
+	} else {
+		data = malloc(head.size);
+		assert(data);
+
+		*warm = head.size == fread(data, 1, head.size, file);
+		if (!*warm) printf("Warning: pipeline cache truncated\n");
+	}
+
+	if (file) fclose(file);
+
+	VkPipelineCacheCreateInfo cache_create_info = {
+	STYPE(PIPELINE_CACHE_CREATE_INFO)
+		.flags = 0,
+		.initialDataSize = *warm ? head.size : 0,
+		.pInitialData = *warm ? data : NULL,
+		.pNext = NULL,
+	};
+
+	VkPipelineCache cache;
+	VkResult err = vkCreatePipelineCache(
+		dev.log,
+		&cache_create_info,
+		NULL,
+		&cache
+	);
+
+	free(data);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to create pipeline cache");
+	}
+
+	printf(
+		"Created pipeline cache (%s, %" PRIu64 " bytes)\n",
+		*warm ? "warm" : "cold",
+		*warm ? head.size : 0
+	);
+
+	return cache;
+}
+
+static void cache_write(struct dev dev, VkPipelineCache cache)
+{
+	struct cache_head head = {
+		.magic = CACHE_MAGIC,
+		.driver = dev.props.driverVersion,
+	};
+
+	memcpy(head.uuid, dev.props.pipelineCacheUUID, VK_UUID_SIZE);
+
+	size_t size;
+	vkGetPipelineCacheData(dev.log, cache, &size, NULL);
+	void *data = malloc(size);
+	assert(data);
+	vkGetPipelineCacheData(dev.log, cache, &size, data);
+	head.size = size;
+
+	strncpy(filename, "pipeline.cache", 14 + 1);
+	FILE *file = fopen(root_path, "wb");
+	if (!file) {
+		fprintf(stderr, "Error opening file at path \"%s\"\n", root_path);
+		free(data);
+		return;
+	}
+
+	fwrite(&head, sizeof(head), 1, file);
+	fwrite(data, 1, size, file);
+	fclose(file);
+	free(data);
+
+	printf("Wrote %zu bytes to \"%s\"\n", size, root_path);
+}
+
+static struct pipeline mk_pipe(
+	VkDevice dev,
+	VkPipelineCache cache,
+	struct desc desc,
+	struct pipeline_template *template
+) {
+	VkResult err;
+
+	// Dynamic (see record_graphics())
+	VkPipelineViewportStateCreateInfo viewport_state_create_info = {
+	STYPE(PIPELINE_VIEWPORT_STATE_CREATE_INFO)
+		.flags = 0,
+		.viewportCount = 1,
+		.pViewports = NULL,
+		.scissorCount = 1,
+		.pScissors = NULL,
+		.pNext = NULL,
+	};
+
+	VkPipelineLayoutCreateInfo pipe_layout_create_info = {
+	STYPE(PIPELINE_LAYOUT_CREATE_INFO)
+		.flags = 0,
+		.setLayoutCount = desc.lay_count,
+		.pSetLayouts = desc.layouts,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = NULL,
+		.pNext = NULL,
+	};
+
+	VkPipelineLayout null_pipe_layout;
+	err = vkCreatePipelineLayout(
+		dev,
+		&pipe_layout_create_info,
+		NULL,
+		&null_pipe_layout
+	);
+
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to create pipeline layout");
+	}
+
+	printf("Created pipeline layout\n");
+
+	// Fill template
+	template->data.pViewportState = &viewport_state_create_info;
+	template->data.layout = null_pipe_layout;
+
+	u64 t = now_ns();
+	VkPipeline pipeline;
+	err = vkCreateGraphicsPipelines(
+		dev,
+		cache,
+		1,
+		&template->data,
+		NULL,
+		&pipeline
+	);
+
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to create graphics pipeline");
+	}
+
+	printf("Created graphics pipeline (%.2fms)\n", (now_ns() - t) * 1e-6);
+	return (struct pipeline) {
+		null_pipe_layout,
+		pipeline,
+	};
+}
+
+static struct cull mk_cull(
 	VkDevice dev,
-	struct extent extent,
+	VkPipelineCache cache,
 	struct desc desc,
-	struct pipeline_template *template
+	int packed,
+	int direct
 ) {
 	VkResult err;
 
-	VkViewport viewport = {
-		.x = 0.f,
-		.y = 0.f,
-		.width = extent.w,
-		.height = extent.h,
-		.minDepth = 0.f,
-		.maxDepth = 1.f,
-	};
+	if      (packed) strncpy(filename, "cull_packed.spv", 15 + 1);
+	else if (direct) strncpy(filename, "cull_direct.spv", 15 + 1);
+	else             strncpy(filename, "cull.spv", 8 + 1);
+	struct ak_shader comp = ak_shader_mk(dev, root_path);
 
-	VkRect2D scissor = {
-		.offset = { 0, 0 },
-		.extent = { extent.w, extent.h },
-	};
+	printf("Created culling shader module\n");
 
-	VkPipelineViewportStateCreateInfo viewport_state_create_info = {
-	STYPE(PIPELINE_VIEWPORT_STATE_CREATE_INFO)
-		.flags = 0,
-		.viewportCount = 1,
-		.pViewports = &viewport,
-		.scissorCount = 1,
-		.pScissors = &scissor,
-		.pNext = NULL,
+	// Shares the graphics set layouts
+	VkPushConstantRange push_range = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(u32), // Draw index
 	};
 
 	VkPipelineLayoutCreateInfo pipe_layout_create_info = {
@@ -1585,46 +3974,59 @@ static struct pipeline mk_pipe(
 		.flags = 0,
 		.setLayoutCount = desc.lay_count,
 		.pSetLayouts = desc.layouts,
-		.pushConstantRangeCount = 0,
-		.pPushConstantRanges = NULL,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_range,
 		.pNext = NULL,
 	};
 
-	VkPipelineLayout null_pipe_layout;
+	VkPipelineLayout layout;
 	err = vkCreatePipelineLayout(
 		dev,
 		&pipe_layout_create_info,
 		NULL,
-		&null_pipe_layout
+		&layout
 	);
 
 	if (err != VK_SUCCESS) {
-		panic_msg("unable to create pipeline layout");
+		panic_msg("unable to create culling pipeline layout");
 	}
 
-	printf("Created pipeline layout\n");
-
-	// Fill template
-	template->data.pViewportState = &viewport_state_create_info;
-	template->data.layout = null_pipe_layout;
+	VkComputePipelineCreateInfo pipe_create_info = {
+	STYPE(COMPUTE_PIPELINE_CREATE_INFO)
+		.flags = 0,
+		.stage = {
+		STYPE(PIPELINE_SHADER_STAGE_CREATE_INFO)
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = comp.mod,
+			.pName = "main",
+			.pSpecializationInfo = NULL,
+			.pNext = NULL,
+		},
+		.layout = layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = 0,
+		.pNext = NULL,
+	};
 
 	VkPipeline pipeline;
-	err = vkCreateGraphicsPipelines(
+	err = vkCreateComputePipelines(
 		dev,
-		VK_NULL_HANDLE,
+		cache,
 		1,
-		&template->data,
+		&pipe_create_info,
 		NULL,
 		&pipeline
 	);
 
 	if (err != VK_SUCCESS) {
-		panic_msg("unable to create graphics pipeline");
+		panic_msg("unable to create culling pipeline");
 	}
 
-	printf("Created graphics pipeline\n");
-	return (struct pipeline) {
-		null_pipe_layout,
+	printf("Created culling pipeline\n");
+	return (struct cull) {
+		comp,
+		layout,
 		pipeline,
 	};
 }
@@ -1657,19 +4059,25 @@ static struct frame mk_fbuffers(
 		.pNext = NULL,
 	};
 
-	VkImageView *views = malloc(3 * sizeof(VkImageView) * SWAP_IMG_COUNT);
+	VkImageView *views = malloc(3 * sizeof(VkImageView) * swap.img_count);
 	assert(views);
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
-		views[3 * i + 0] = swap.aa.view;
+	for (size_t i = 0; i < swap.img_count; ++i) {
 		views[3 * i + 1] = swap.depth.view;
+		views[3 * i + 2] = swap.aa.view;
+
+		// Swapchain images are only blitted into when scaled
+		if (swap.scene.view) {
+			views[3 * i + 0] = swap.scene.view;
+			continue;
+		}
 
 		view_create_info.image = swap.img[i];
 		err = vkCreateImageView(
 			dev,
 			&view_create_info,
 			NULL,
-			&views[3 * i + 2]
+			&views[3 * i + 0]
 		);
 
 		if (err != VK_SUCCESS) {
@@ -1677,13 +4085,14 @@ static struct frame mk_fbuffers(
 		}
 	}
 
-	printf("Created %u image views\n", SWAP_IMG_COUNT);
+	if (!swap.scene.view)
+		printf("Created %u image views\n", swap.img_count);
 
 	VkFramebufferCreateInfo fbuffer_create_info = {
 	STYPE(FRAMEBUFFER_CREATE_INFO)
 		.flags = 0,
 		.renderPass = pass,
-		.attachmentCount = 3,
+		.attachmentCount = swap.aa.view ? 3 : 2, // No aa buffer at 1x
 		.width = swap.extent.w,
 		.height = swap.extent.h,
 		.layers = 1,
@@ -1691,12 +4100,12 @@ static struct frame mk_fbuffers(
 	};
 
 	VkFramebuffer *fbuffers = malloc(
-		sizeof(VkFramebuffer) * SWAP_IMG_COUNT
+		sizeof(VkFramebuffer) * swap.img_count
 	);
 
 	assert(fbuffers);
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
+	for (size_t i = 0; i < swap.img_count; ++i) {
 		fbuffer_create_info.pAttachments = views + 3 * i;
 		err = vkCreateFramebuffer(
 			dev,
@@ -1710,35 +4119,198 @@ static struct frame mk_fbuffers(
 		}
 	}
 
-	printf("Created %u framebuffers\n", SWAP_IMG_COUNT);
+	printf("Created %u framebuffers\n", swap.img_count);
 	return (struct frame) {
 		views,
 		fbuffers,
 	};
 }
 
+/* Dynamic resolution;
+ * the scene is drawn into a corner of full-size targets at one of
+ * SCALE_STEPS scales, each with its own command buffers, then upscaled
+ */
+
+static struct scale {
+	float budget; // Seconds; zero => fixed at full resolution
+	float ema;    // Smoothed frame time
+	u32 step;     // Zero is full resolution
+	u32 hold;     // Frames until the next step
+} scale;
+
+static u32 scale_steps(struct swap swap)
+{
+	return swap.scene.view ? SCALE_STEPS : 1;
+}
+
+static float scale_of(u32 step)
+{
+	return 1.f - step * (1.f - SCALE_MIN) / (SCALE_STEPS - 1);
+}
+
+static struct extent scale_extent(struct extent extent, u32 step)
+{
+	float s = scale_of(step);
+	return (struct extent) {
+		maxf(1.f, roundf(extent.w * s)),
+		maxf(1.f, roundf(extent.h * s)),
+	};
+}
+
+/* The controller needs device time; without it, GPU-bound frames look
+ * cheap and the scale would only follow host work
+ */
+static int scale_check(struct dev dev, int scaled)
+{
+	if (!scaled || dev.ts_bits) return scaled;
+
+	printf("Warning: timestamp queries unsupported; render scale fixed\n");
+	scale.budget = 0.f;
+	return 0;
+}
+
+static void scale_update(float t)
+{
+	if (!scale.budget) return;
+	scale.ema = scale.ema ? lerpf(scale.ema, t, SCALE_EMA) : t;
+
+	if (scale.hold) {
+		--scale.hold;
+		return;
+	}
+
+	// Cost is assumed to follow the pixel count
+	float up = 0;
+	if (scale.step) {
+		float r = scale_of(scale.step - 1) / scale_of(scale.step);
+		up = scale.ema * r * r;
+	}
+
+	if (scale.ema > scale.budget && scale.step < SCALE_STEPS - 1) {
+		++scale.step;
+	} else if (scale.step && up < scale.budget * SCALE_HEADROOM) {
+		--scale.step;
+	} else return;
+
+	scale.hold = SCALE_HOLD;
+#ifdef TXT_DEBUG
+	printf("Render scale %.2f\n", scale_of(scale.step));
+#endif
+}
+
+// Scene (left in transfer source layout by the render pass) to image i
+static void record_upscale(
+	VkCommandBuffer cmd,
+	struct swap swap,
+	size_t i,
+	struct extent area
+) {
+	VkImageMemoryBarrier barrier = {
+	STYPE(IMAGE_MEMORY_BARRIER)
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = swap.img[i],
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.pNext = NULL,
+	};
+
+	// Chained to the acquire semaphore wait (see run())
+	vkCmdPipelineBarrier(
+		cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, NULL,
+		0, NULL,
+		1, &barrier
+	);
+
+	VkImageBlit region = {
+		.srcSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.srcOffsets = { { 0, 0, 0 }, { area.w, area.h, 1 } },
+		.dstSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.dstOffsets = {
+			{ 0, 0, 0 },
+			{ swap.extent.w, swap.extent.h, 1 },
+		},
+	};
+
+	vkCmdBlitImage(
+		cmd,
+		swap.scene.img,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		swap.img[i],
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1,
+		&region,
+		VK_FILTER_LINEAR
+	);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = swap.chain ?
+		  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		: VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	vkCmdPipelineBarrier(
+		cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, NULL,
+		0, NULL,
+		1, &barrier
+	);
+}
+
 static VkCommandBuffer *record_graphics(
 	VkDevice dev,
 	struct swap swap,
 	VkDescriptorSet *sets,
 	struct graphics graphics,
 	struct pipeline pipe,
+	struct cull cull,
 	struct frame frame,
+	struct buf indirect,
+	int retained,
+	u32 frames,
+	struct query query,
 	VkCommandPool pool,
 	v3 clear_col
 ) {
+	// One per render scale, frame in flight, and swapchain image
+	u32 cmd_count = scale_steps(swap) * frames * swap.img_count;
+
 	VkCommandBufferAllocateInfo cmd_alloc_info = {
 	STYPE(COMMAND_BUFFER_ALLOCATE_INFO)
 		.commandPool = pool,
 		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = SWAP_IMG_COUNT,
+		.commandBufferCount = cmd_count,
 		.pNext = NULL,
 	};
 
-	VkCommandBuffer *cmd = malloc(
-		sizeof(VkCommandBuffer) * SWAP_IMG_COUNT
-	);
-
+	VkCommandBuffer *cmd = malloc(sizeof(VkCommandBuffer) * cmd_count);
 	assert(cmd);
 
 	VkResult err = vkAllocateCommandBuffers(dev, &cmd_alloc_info, cmd);
@@ -1746,7 +4318,7 @@ static VkCommandBuffer *record_graphics(
 		panic_msg("unable to allocate command buffers\n");
 	}
 
-	printf("Allocated %u command buffers\n", SWAP_IMG_COUNT);
+	printf("Allocated %u command buffers\n", cmd_count);
 
 	VkCommandBufferBeginInfo begin_info = {
 	STYPE(COMMAND_BUFFER_BEGIN_INFO)
@@ -1755,54 +4327,162 @@ static VkCommandBuffer *record_graphics(
 		.pNext = NULL,
 	};
 
+	// Indexed by attachment; the first only clears at 1x
 	VkClearValue clears[] = {
 		{ clear_col.x, clear_col.y, clear_col.z, 1 },
 		{ 0, 0 },
+		{ clear_col.x, clear_col.y, clear_col.z, 1 },
 	};
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
-		err = vkBeginCommandBuffer(cmd[i], &begin_info);
+	for (size_t c = 0; c < cmd_count; ++c) {
+		size_t s = c / (frames * swap.img_count);
+		size_t f = c / swap.img_count % frames;
+		size_t i = c % swap.img_count;
+		struct extent area = scale_extent(swap.extent, s);
+
+		err = vkBeginCommandBuffer(cmd[c], &begin_info);
 		if (err != VK_SUCCESS) {
 			panic_msg("unable to begin command buffer recording");
 		}
 
+		if (query.ts) {
+			vkCmdResetQueryPool(cmd[c], query.ts, 2 * f, 2);
+			vkCmdWriteTimestamp(
+				cmd[c],
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				query.ts,
+				2 * f
+			);
+		}
+
+		if (query.pipe) {
+			vkCmdResetQueryPool(cmd[c], query.pipe, f, 1);
+			vkCmdBeginQuery(cmd[c], query.pipe, f, 0);
+		}
+
+		/* Culling pre-pass; sizes come from the host via indirect args */
+
+		for (u32 k = 0; cull.line && k < 1 + !!retained; ++k) {
+			VkDescriptorSet cull_sets[4] = {
+				sets[0], // Glyph bounds
+				sets[1 + f],
+				sets[1 + (1 + k) * frames + f],
+				sets[1 + (2 + !!retained) * frames + f],
+			};
+
+			vkCmdBindPipeline(
+				cmd[c],
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				cull.line
+			);
+
+			vkCmdBindDescriptorSets(
+				cmd[c],
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				cull.layout,
+				0,
+				4,
+				cull_sets,
+				0,
+				NULL
+			);
+
+			vkCmdPushConstants(
+				cmd[c],
+				cull.layout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				0,
+				sizeof(u32),
+				&k
+			);
+
+			vkCmdDispatchIndirect(
+				cmd[c],
+				indirect.gpu.buf,
+				f * indirect.frame_size
+					+ offsetof(struct indirect, cull)
+					+ k * sizeof(VkDispatchIndirectCommand)
+			);
+		}
+
+		if (cull.line) {
+			VkMemoryBarrier barrier = {
+			STYPE(MEMORY_BARRIER)
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+				               | VK_ACCESS_SHADER_READ_BIT,
+				.pNext = NULL,
+			};
+
+			vkCmdPipelineBarrier(
+				cmd[c],
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+					| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				0,
+				1,
+				&barrier,
+				0,
+				NULL,
+				0,
+				NULL
+			);
+		}
+
 		VkRenderPassBeginInfo pass_beg_info = {
 		STYPE(RENDER_PASS_BEGIN_INFO)
 			.renderPass = graphics.pass,
 			.framebuffer = frame.buffers[i],
 			.renderArea = {
 				.offset = { 0, 0 },
-				.extent = { swap.extent.w, swap.extent.h },
+				.extent = { area.w, area.h },
 			},
-			.clearValueCount = 2,
+			.clearValueCount = 3,
 			.pClearValues = clears,
 			.pNext = NULL,
 		};
 
 		vkCmdBeginRenderPass(
-			cmd[i],
+			cmd[c],
 			&pass_beg_info,
 			VK_SUBPASS_CONTENTS_INLINE
 		);
 
 		vkCmdBindPipeline(
-			cmd[i],
+			cmd[c],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipe.line
 		);
 
+		VkViewport viewport = {
+			.x = 0.f,
+			.y = 0.f,
+			.width = area.w,
+			.height = area.h,
+			.minDepth = 0.f,
+			.maxDepth = 1.f,
+		};
+
+		VkRect2D scissor = {
+			.offset = { 0, 0 },
+			.extent = { area.w, area.h },
+		};
+
+		vkCmdSetViewport(cmd[c], 0, 1, &viewport);
+		vkCmdSetScissor(cmd[c], 0, 1, &scissor);
+
 #ifdef PLATFORM_COMPAT_VBO
 		VkDeviceSize off = 0;
-		vkCmdBindVertexBuffers(cmd[i], 0, 1, &graphics.quad.buf, &off);
+		vkCmdBindVertexBuffers(cmd[c], 0, 1, &graphics.quad.buf, &off);
 #endif
 		VkDescriptorSet frame_sets[3] = {
 			sets[0],
-			sets[1 + i],
-			sets[1 + SWAP_IMG_COUNT + i],
+			sets[1 + f],
+			sets[1 + frames + f],
 		};
 
 		vkCmdBindDescriptorSets(
-			cmd[i],
+			cmd[c],
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipe.layout,
 			0,
@@ -1812,40 +4492,98 @@ static VkCommandBuffer *record_graphics(
 			NULL
 		);
 
-		vkCmdDraw(cmd[i], 4, MAX_QUAD, 0, 0); // Quad
-		vkCmdEndRenderPass(cmd[i]);
+		vkCmdDrawIndirect( // Quads
+			cmd[c],
+			indirect.gpu.buf,
+			f * indirect.frame_size,
+			1,
+			indirect.stride
+		);
+
+		if (retained) {
+			vkCmdBindDescriptorSets(
+				cmd[c],
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipe.layout,
+				2,
+				1,
+				sets + 1 + 2 * frames + f,
+				0,
+				NULL
+			);
+
+			vkCmdDrawIndirect( // Retained quads
+				cmd[c],
+				indirect.gpu.buf,
+				f * indirect.frame_size + indirect.stride,
+				1,
+				indirect.stride
+			);
+		}
+
+		vkCmdEndRenderPass(cmd[c]);
+		if (swap.scene.view) record_upscale(cmd[c], swap, i, area);
+
+		if (query.pipe) vkCmdEndQuery(cmd[c], query.pipe, f);
+		if (query.ts) vkCmdWriteTimestamp(
+			cmd[c],
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			query.ts,
+			2 * f + 1
+		);
 
-		err = vkEndCommandBuffer(cmd[i]);
+		err = vkEndCommandBuffer(cmd[c]);
 		if (err != VK_SUCCESS) {
 			panic_msg("unable to end command buffer recording");
 		}
 
-		printf("Recorded command buffer [%zu]\n", i);
+		printf("Recorded command buffer [%zu, %zu, %zu]\n", s, f, i);
 	}
 
 	return cmd;
 }
 
-static struct sync mk_sync(VkDevice dev)
+// Render semaphores, per swapchain image
+static VkSemaphore *mk_sems(VkDevice dev, u32 img_n)
 {
-	VkResult err;
-	VkFenceCreateInfo fence_create_info = {
-	STYPE(FENCE_CREATE_INFO)
+	VkSemaphoreCreateInfo sem_create_info = {
+	STYPE(SEMAPHORE_CREATE_INFO)
 		.flags = 0,
 		.pNext = NULL,
 	};
 
-	VkFence acq_fence;
-	err = vkCreateFence(dev, &fence_create_info, NULL, &acq_fence);
-	if (err != VK_SUCCESS) {
-		panic_msg("unable to create acquisition fence");
+	VkSemaphore *sem = malloc(sizeof(VkSemaphore) * img_n);
+	assert(sem);
+
+	for (size_t i = 0; i < img_n; ++i) {
+		VkResult err = vkCreateSemaphore(
+			dev,
+			&sem_create_info,
+			NULL,
+			&sem[i]
+		);
+
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to create semaphore");
+		}
 	}
 
-	fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	VkFence *sub_fence = malloc(sizeof(VkFence) * SWAP_IMG_COUNT);
+	return sem;
+}
+
+static struct sync mk_sync(VkDevice dev, u32 frames, u32 img_n)
+{
+	VkResult err;
+	VkFenceCreateInfo fence_create_info = {
+	STYPE(FENCE_CREATE_INFO)
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT,
+		.pNext = NULL,
+	};
+
+	VkFence *sub_fence = malloc(sizeof(VkFence) * frames);
 	assert(sub_fence);
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
+	for (size_t i = 0; i < frames; ++i) {
 		err = vkCreateFence(
 			dev,
 			&fence_create_info,
@@ -1858,10 +4596,7 @@ static struct sync mk_sync(VkDevice dev)
 		}
 	}
 
-	printf(
-		"Created acquisition and submit fences (%u)\n",
-		SWAP_IMG_COUNT + 1
-	);
+	printf("Created submit fences (%u)\n", frames);
 
 	VkSemaphoreCreateInfo sem_create_info = {
 	STYPE(SEMAPHORE_CREATE_INFO)
@@ -1869,57 +4604,253 @@ static struct sync mk_sync(VkDevice dev)
 		.pNext = NULL,
 	};
 
-	VkSemaphore *sem = malloc(sizeof(VkSemaphore) * SWAP_IMG_COUNT);
-	assert(sem);
+	VkSemaphore *acq_sem = malloc(sizeof(VkSemaphore) * frames);
+	assert(acq_sem);
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
-		err = vkCreateSemaphore(dev, &sem_create_info, NULL, &sem[i]);
+	for (size_t i = 0; i < frames; ++i) {
+		err = vkCreateSemaphore(dev, &sem_create_info, NULL, &acq_sem[i]);
 		if (err != VK_SUCCESS) {
-			panic_msg("unable to create semaphore");
+			panic_msg("unable to create acquisition semaphore");
 		}
 	}
 
-	printf("Created %u semaphores\n", SWAP_IMG_COUNT);
+	VkSemaphore *sem = mk_sems(dev, img_n);
+	printf("Created %u semaphores\n", frames + img_n);
 	return (struct sync) {
-		acq_fence,
+		frames,
+		img_n,
+		acq_sem,
 		sub_fence,
 		sem,
 	};
 }
 
-static void swap_free(
+// Timestamps are also made for the render scale controller (timed)
+static struct query mk_query(
+	struct dev dev,
+	u32 frames,
+	int pipe_stats,
+	int timed
+) {
+	struct query query = { 0 };
+	VkResult err;
+#ifndef TXT_STATS
+	if (!timed) return query;
+#endif
+
+	if (!dev.ts_bits) {
+		printf("Warning: timestamp queries unsupported\n");
+	} else {
+		VkQueryPoolCreateInfo ts_create_info = {
+		STYPE(QUERY_POOL_CREATE_INFO)
+			.flags = 0,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2 * frames,
+			.pipelineStatistics = 0,
+			.pNext = NULL,
+		};
+
+		err = vkCreateQueryPool(dev.log, &ts_create_info, NULL, &query.ts);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to create timestamp query pool");
+		}
+
+		query.ts_mask = dev.ts_bits < 64 ?
+			(1ull << dev.ts_bits) - 1 : ~0ull;
+		query.period = dev.props.limits.timestampPeriod;
+		printf("Created timestamp query pool (%u)\n", 2 * frames);
+	}
+
+#ifdef TXT_STATS
+	if (!pipe_stats) return query;
+	if (!dev.feats.pipelineStatisticsQuery) {
+		printf("Warning: pipeline statistics queries unsupported\n");
+		return query;
+	}
+
+	VkQueryPoolCreateInfo pipe_create_info = {
+	STYPE(QUERY_POOL_CREATE_INFO)
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		.queryCount = frames,
+		// Results are written in bit order
+		.pipelineStatistics =
+			  VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+		.pNext = NULL,
+	};
+
+	err = vkCreateQueryPool(dev.log, &pipe_create_info, NULL, &query.pipe);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to create pipeline statistics query pool");
+	}
+
+	printf("Created pipeline statistics query pool (%u)\n", frames);
+#endif
+	return query;
+}
+
+// Device nanoseconds of the slot's last submit, or zero if unknown;
+// call only after the slot's fence has signaled, never blocks
+static u64 query_gpu(VkDevice dev, struct query query, u32 slot)
+{
+	if (!query.ts) return 0;
+
+	u64 ts[2];
+	VkResult err = vkGetQueryPoolResults(
+		dev,
+		query.ts,
+		2 * slot,
+		2,
+		sizeof(ts),
+		ts,
+		sizeof(u64),
+		VK_QUERY_RESULT_64_BIT
+	);
+
+	if (err != VK_SUCCESS) return 0;
+	u64 ticks = (ts[1] - ts[0]) & query.ts_mask;
+	return ticks * query.period;
+}
+
+#ifdef TXT_STATS
+// Call only after the slot's fence has signaled; never blocks
+static void query_read(VkDevice dev, struct query query, u32 slot)
+{
+	VkResult err;
+
+	if (query.pipe) {
+		u64 counts[3];
+		err = vkGetQueryPoolResults(
+			dev,
+			query.pipe,
+			slot,
+			1,
+			sizeof(counts),
+			counts,
+			sizeof(counts),
+			VK_QUERY_RESULT_64_BIT
+		);
+
+		if (err == VK_SUCCESS) {
+			phase.vert_invoc = counts[0];
+			phase.clip_invoc = counts[1];
+			phase.frag_invoc = counts[2];
+		}
+	}
+}
+#endif
+
+static void swap_free(
+	VkDevice dev,
+	struct swap swap,
+	struct frame frame,
+	VkCommandPool pool,
+	VkCommandBuffer *cmd,
+	u32 frames
+) {
+	u32 cmd_count = scale_steps(swap) * frames * swap.img_count;
+	vkFreeCommandBuffers(dev, pool, cmd_count, cmd);
+	free(cmd);
+
+	for (size_t i = 0; i < swap.img_count; ++i) {
+		if (!swap.scene.view)
+			vkDestroyImageView(dev, frame.views[3 * i + 0], NULL);
+		vkDestroyFramebuffer(dev, frame.buffers[i], NULL);
+	}
+
+	free(frame.views);
+	free(frame.buffers);
+
+	if (swap.chain) vkDestroySwapchainKHR(dev, swap.chain, NULL);
+	else ak_img_free(dev, swap.off);
+	free(swap.img);
+}
+
+static void targets_free(VkDevice dev, struct swap swap)
+{
+	ak_img_free(dev, swap.aa);
+	ak_img_free(dev, swap.depth);
+	ak_img_free(dev, swap.scene);
+}
+
+/* Swapchain retirement;
+ * objects replaced by reswap() may still be in use by frames in flight,
+ * so they are freed once every slot's fence has been waited on since
+ */
+
+#define RETIRE_MAX (MAX_FRAMES_IN_FLIGHT + 1)
+
+static struct retire {
+	struct old {
+		struct swap swap;
+		struct frame frame;
+		VkCommandBuffer *cmd;
+		int targets; // Zero if carried over to the new swapchain
+		VkSemaphore *sem; // Null unless the image count changed
+		u64 after; // Submission count
+	} q[RETIRE_MAX];
+	u32 n;
+} retire;
+
+// With all set, the caller guarantees the device is idle
+static void retire_collect(
 	VkDevice dev,
-	struct swap swap,
-	struct pipeline pipe,
-	struct frame frame,
 	VkCommandPool pool,
-	VkCommandBuffer *cmd
+	u32 frames,
+	u64 submitted,
+	int all
 ) {
-	vkFreeCommandBuffers(dev, pool, SWAP_IMG_COUNT, cmd);
-	free(cmd);
+	u32 keep = 0;
+	for (u32 i = 0; i < retire.n; ++i) {
+		struct old old = retire.q[i];
+		if (!all && submitted < old.after) {
+			retire.q[keep++] = old;
+			continue;
+		}
 
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
-		vkDestroyImageView(dev, frame.views[3 * i + 2], NULL);
-		vkDestroyFramebuffer(dev, frame.buffers[i], NULL);
+		swap_free(dev, old.swap, old.frame, pool, old.cmd, frames);
+		if (old.targets) targets_free(dev, old.swap);
+		if (!old.sem) continue;
+
+		for (u32 j = 0; j < old.swap.img_count; ++j)
+			vkDestroySemaphore(dev, old.sem[j], NULL);
+		free(old.sem);
 	}
 
-	free(frame.views);
-	free(frame.buffers);
+	retire.n = keep;
+}
 
-	vkDestroyPipelineLayout(dev, pipe.layout, NULL);
-	vkDestroyPipeline(dev, pipe.line, NULL);
+static void retire_push(
+	VkDevice dev,
+	VkCommandPool pool,
+	u32 frames,
+	struct old old
+) {
+	if (retire.n == RETIRE_MAX) { // Resized every frame; catch up
+		vkDeviceWaitIdle(dev);
+		retire_collect(dev, pool, frames, 0, 1);
+	}
 
-	vkDestroySwapchainKHR(dev, swap.chain, NULL);
-	free(swap.img);
-	ak_img_free(dev, swap.aa);
-	ak_img_free(dev, swap.depth);
+	retire.q[retire.n++] = old;
 }
 
 struct reswap_data {
 	struct swap *swap;
+	struct sync *sync;
 	struct pipeline *pipe;
+	struct cull cull;
+	VkPipelineCache cache;
 	struct frame *frame;
 	VkCommandBuffer **cmd;
+	struct buf indirect;
+	int retained;
+	u32 frames;
+	struct query query;
+	int present;
+	u32 img_req;
+	int scaled;
 	v3 clear_col;
 };
 
@@ -1930,6 +4861,7 @@ static int reswap(
 	struct graphics graphics,
 	struct desc desc,
 	VkCommandPool pool,
+	u64 submitted,
 	struct reswap_data in
 ) {
 	int fbw, fbh;
@@ -1946,17 +4878,46 @@ static int reswap(
 	struct extent fbs = { fbw, fbh };
 	printf("Recreating swapchain\n");
 
-	swap_free(
-		dev.log,
-		*(in.swap),
-		*(in.pipe),
-		*(in.frame),
-		pool,
-		*(in.cmd)
+	/* The pipeline (dynamic viewport) and the render pass carry over;
+	 * everything else is retired, except same-size targets
+	 */
+
+	struct swap old = *(in.swap);
+	*(in.swap) = mk_swap(
+		old.extent,
+		fbs,
+		dev,
+		win,
+		surf,
+		in.present,
+		in.img_req,
+		in.scaled,
+		&old
 	);
 
-	*(in.swap) = mk_swap(in.swap->extent, fbs, dev, win, surf);
-	*(in.pipe) = mk_pipe(dev.log, in.swap->extent, desc, graphics.template);
+	// Render semaphores are allocated per image
+	VkSemaphore *old_sem = NULL;
+	if (in.swap->img_count != old.img_count) {
+		printf(
+			"Swapchain image count changed (%u to %u)\n",
+			old.img_count,
+			in.swap->img_count
+		);
+
+		old_sem = in.sync->sem;
+		in.sync->sem = mk_sems(dev.log, in.swap->img_count);
+		in.sync->img_n = in.swap->img_count;
+	}
+
+	retire_push(dev.log, pool, in.frames, (struct old) {
+		.swap = old,
+		.frame = *(in.frame),
+		.cmd = *(in.cmd),
+		.targets = old.depth.img != in.swap->depth.img,
+		.sem = old_sem,
+		.after = submitted + in.frames,
+	});
+
 	*(in.frame) = mk_fbuffers(dev.log, *(in.swap), graphics.pass);
 	*(in.cmd) = record_graphics(
 		dev.log,
@@ -1964,7 +4925,12 @@ static int reswap(
 		desc.sets,
 		graphics,
 		*(in.pipe),
+		in.cull,
 		*(in.frame),
+		in.indirect,
+		in.retained,
+		in.frames,
+		in.query,
 		pool,
 		in.clear_col
 	);
@@ -1972,7 +4938,251 @@ static int reswap(
 	return 0;
 }
 
+/* Quad capacity;
+ * the char buffer is reallocated whenever a frame outgrows it,
+ * which rewrites the descriptor sets and re-records every command buffer
+ */
+
+static void rchar_grow(size_t cap)
+{
+	VkDevice dev = app.dev.log;
+	u32 frames = app.sync.frame_n;
+	u32 retained = app.cfg.retained;
+	struct buf old = app.rchar;
+
+	printf("Growing quad capacity to %zu\n", cap);
+	vkDeviceWaitIdle(dev);
+
+	prep_rchar(
+		app.dev,
+		old.stride,
+		cap,
+		retained,
+		frames,
+		app.cfg.device_local,
+		&app.rchar
+	);
+
+	struct buf new = app.rchar;
+
+	// Written quads (zero-copy mode) and the retained pool carry over
+	for (size_t i = 0; i < frames; ++i) {
+		void *src = old.mapped + i * old.frame_size;
+		void *dst = new.mapped + i * new.frame_size;
+		memcpy(dst, src, old.tail);
+		memcpy(dst + new.tail, src + old.tail, retained * old.stride);
+	}
+
+	VkMappedMemoryRange range;
+	if (ak_buf_range(
+		new.gpu,
+		app.dev.props.limits.nonCoherentAtomSize,
+		0,
+		new.gpu.size,
+		&range
+	)) {
+		VkResult err = vkFlushMappedMemoryRanges(dev, 1, &range);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to flush mapped memory");
+		}
+	}
+
+	ak_buf_free(dev, old.gpu);
+	ak_buf_free(dev, old.local);
+	for (size_t i = 0; i < frames; ++i) app.stage.full[i] = 1;
+
+	mk_bindings(
+		dev,
+		app.desc,
+		app.font,
+		app.share,
+		new,
+		retained,
+		frames
+	);
+
+	if (app.cull.line) {
+		ak_buf_free(dev, app.list.gpu);
+		prep_list(app.dev, cap, retained, frames, &app.list);
+		bind_cull(dev, app.desc, app.list, app.indirect, retained, frames);
+	}
+
+	// Updating a bound set invalidates the command buffer
+	vkFreeCommandBuffers(
+		dev,
+		app.pool,
+		scale_steps(app.swap) * frames * app.swap.img_count,
+		app.cmd
+	);
+
+	free(app.cmd);
+	app.cmd = record_graphics(
+		dev,
+		app.swap,
+		app.desc.sets,
+		app.graphics,
+		app.pipe,
+		app.cull,
+		app.frame,
+		app.indirect,
+		!!retained,
+		frames,
+		app.query,
+		app.pool,
+		app.clear_col
+	);
+}
+
+void txtquad_reserve(struct txt_buf *buf, size_t n)
+{
+	if (n <= buf->cap) return;
+	size_t cap = 2 * buf->cap > n ? 2 * buf->cap : n;
+
+	// The char buffer follows on upload
+	if (!app.cfg.zero_copy) {
+		txt_grow(buf, cap);
+		return;
+	}
+
+	// Quads are mapped; stay on the same frame in flight
+	size_t slot = ((void*)buf->quads - app.rchar.mapped)
+		/ app.rchar.frame_size;
+
+	rchar_grow(cap);
+	buf->quads = app.rchar.mapped + slot * app.rchar.frame_size;
+	buf->cap = cap;
+}
+
+/* Frame statistics */
+
+static struct stats {
+	float dt[STATS_FRAMES];
+	float quads[STATS_FRAMES];
+	u64 n; // Total frames recorded
+} stats;
+
+static void stats_push(float dt, u32 quads)
+{
+	size_t i = stats.n++ % STATS_FRAMES;
+	stats.dt[i] = dt;
+	stats.quads[i] = quads;
+}
+
+static int cmp_float(const void *a, const void *b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+// Sorts in place
+static struct txt_dist stats_dist(float *v, size_t n)
+{
+	if (!n) return (struct txt_dist) { 0 };
+	qsort(v, n, sizeof(float), cmp_float);
+
+	#define RANK(P) v[(size_t)ceilf((P) * n) - 1] // Nearest rank
+	struct txt_dist result = {
+		.p50 = RANK(.50f),
+		.p95 = RANK(.95f),
+		.p99 = RANK(.99f),
+		.max = v[n - 1],
+	};
+	#undef RANK
+
+	return result;
+}
+
+struct txt_frame_stats txtquad_frame_stats()
+{
+	size_t n = stats.n < STATS_FRAMES ? stats.n : STATS_FRAMES;
+	float scratch[STATS_FRAMES];
+
+	memcpy(scratch, stats.dt, n * sizeof(float));
+	struct txt_dist dt = stats_dist(scratch, n);
+	memcpy(scratch, stats.quads, n * sizeof(float));
+	struct txt_dist quads = stats_dist(scratch, n);
+
+	return (struct txt_frame_stats) { dt, quads, n };
+}
+
+static void stats_dump(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "Error opening file at path \"%s\"\n", path);
+		return;
+	}
+
+	// Oldest first
+	size_t n = stats.n < STATS_FRAMES ? stats.n : STATS_FRAMES;
+	fprintf(file, "frame,dt_ms,quads\n");
+
+	for (u64 k = stats.n - n; k < stats.n; ++k) {
+		size_t i = k % STATS_FRAMES;
+		fprintf(
+			file,
+			"%" PRIu64 ",%.4f,%.0f\n",
+			k,
+			stats.dt[i] * 1000.f,
+			stats.quads[i]
+		);
+	}
+
+	fclose(file);
+	printf("Wrote %zu frame samples to \"%s\"\n", n, path);
+}
+
+/* Phase timing; compiles out without TXT_STATS */
+
+#ifdef TXT_STATS
+static struct txt_stats phase;
+#define STAT_BEG(PHASE) u64 stat_ ## PHASE = now_ns()
+#define STAT_END(PHASE) phase.PHASE += now_ns() - stat_ ## PHASE
+#define STAT_ADD(FIELD, N) phase.FIELD += (N)
+#else
+#define STAT_BEG(_) ;
+#define STAT_END(_) ;
+#define STAT_ADD(_, __) ;
+#endif
+
 static int done;
+static u64 t_start;
+
+void txtquad_stop()
+{
+	done = 1;
+}
+
+static void frame_poll(
+	GLFWwindow *win,
+	struct txt_frame *frame,
+	struct Input *inp
+) {
+	++frame->i;
+	float t = (now_ns() - t_start) * 1e-9;
+	frame->dt = minf(t - frame->t_prev, MAX_DT);
+	frame->t_prev = t;
+	frame->t += frame->dt;
+#ifdef TXT_DEBUG
+	frame->acc += frame->dt;
+	if (frame->acc > 1) {
+		printf(
+			"FPS=%zu\tdt=%.3fms\n",
+			frame->i - frame->i_last,
+			frame->dt * 1000
+		);
+
+		frame->i_last = frame->i;
+		frame->acc = 0;
+	}
+#endif
+	if (!win) return; // Headless
+	glfwPollEvents();
+#ifdef INP_KEYS
+	inp_update(win, inp);
+#endif
+}
+
 static void run(
 	GLFWwindow *win,
 	VkSurfaceKHR surf,
@@ -1982,11 +5192,16 @@ static void run(
 	VkCommandPool pool,
 	struct sync sync,
 	struct buf share,
-	struct buf rchar,
+	struct buf *rchar, // Reallocated on growth
+	struct txt_cfg cfg,
 	struct reswap_data vol
 ) {
 	printf("Initializing update data...\n");
-	glfwSetTime(0);
+	t_start = now_ns();
+
+	int mode = cfg.zero_copy ? JOB_COPY
+		: cfg.quads == QUADS_PACKED ? JOB_PACK
+		: JOB_CONV;
 
 	printf("Entering render loop...\n");
 	unsigned int img_i;
@@ -1996,18 +5211,70 @@ static void run(
 		.t = 0.f,
 	};
 
+	struct Input *inp = NULL;
+#ifdef INP_KEYS
+	// Private copy while the update thread reads inp_data
+	struct Input inp_live = inp_data;
+	inp = cfg.threaded ? &inp_live : &inp_data;
+#endif
+
+	u64 period = cfg.fps_max ? 1000000000ull / cfg.fps_max : 0;
+	u64 pace_next = now_ns();
+	u64 stats_prev = pace_next;
+	u64 stats_refresh = pace_next;
+
 	VkResult err;
+	u32 slot = 0; // Frame in flight
+	u64 submitted = 0;
 	while (!done) {
-		if (glfwWindowShouldClose(win)) break;
+		if (win && glfwWindowShouldClose(win)) break;
+		if (cfg.frame_count && submitted == cfg.frame_count) break;
+#ifdef TXT_STATS
+		frame.phases = phase; // Previous iteration
+		memset(&phase, 0, sizeof(phase));
+#endif
+		STAT_BEG(pace);
+		if (period) pace(&pace_next, period);
+		STAT_END(pace);
+
+		// Buffers for this slot are free once its last submit retires
+		STAT_BEG(wait);
+		vkWaitForFences(
+			dev.log,
+			1,
+			sync.submit + slot,
+			VK_TRUE,
+			UINT64_MAX
+		);
+		STAT_END(wait);
+		if (retire.n) {
+			retire_collect(dev.log, pool, sync.frame_n, submitted, 0);
+		}
+
+		upload_done(upload.last); // Frees staging of finished uploads
+		// Written by the last submit on this slot
+		u64 gpu = 0;
+		if (submitted >= sync.frame_n) {
+			gpu = query_gpu(dev.log, vol.query, slot);
+#ifdef TXT_STATS
+			if (gpu) phase.gpu = gpu;
+			query_read(dev.log, vol.query, slot);
+#endif
+		}
 
-		err = vkAcquireNextImageKHR(
+		err = VK_SUCCESS;
+		img_i = 0;
+
+		STAT_BEG(acquire);
+		if (win) err = vkAcquireNextImageKHR(
 			dev.log,
 			vol.swap->chain,
 			UINT64_MAX,
-			NULL,
-			sync.acquire,
+			sync.acquire[slot],
+			VK_NULL_HANDLE,
 			&img_i
 		);
+		STAT_END(acquire);
 
 		switch (err) {
 		case VK_SUCCESS:
@@ -2015,8 +5282,18 @@ static void run(
 			break;
 		case VK_ERROR_OUT_OF_DATE_KHR:
 			printf("Swapchain unsuitable for image acquisition\n");
-			vkDeviceWaitIdle(dev.log);
-			done = reswap(win, surf, dev, graphics, desc, pool, vol);
+			done = reswap(
+				win,
+				surf,
+				dev,
+				graphics,
+				desc,
+				pool,
+				submitted,
+				vol
+			);
+
+			sync = *vol.sync; // Render semaphores may be reallocated
 			frame.size = vol.swap->extent;
 			continue;
 		default:
@@ -2029,69 +5306,221 @@ static void run(
 			panic();
 		}
 
-		++frame.i;
-		float t = glfwGetTime();
-		frame.dt = minf(t - frame.t_prev, MAX_DT);
-		frame.t_prev = t;
-		frame.t += frame.dt;
-#ifdef TXT_DEBUG
-		frame.acc += frame.dt;
-		if (frame.acc > 1) {
-			printf(
-				"FPS=%zu\tdt=%.3fms\n",
-				frame.i - frame.i_last,
-				frame.dt * 1000
-			);
+		// Host work, past the pacing, fence and acquire waits
+		u64 work_beg = now_ns();
+
+		void *rchar_buf = rchar->mapped + slot * rchar->frame_size;
+		void *share_buf = share.mapped + slot * share.frame_size;
+		struct txt_buf *buf;
+		struct range dirty;
+		u32 retain_hi;
+
+#ifdef PLATFORM_THREADS
+		if (cfg.threaded) {
+			STAT_BEG(update); // Time spent waiting on the update thread
+			if (!produce_pending()) { // First frame
+				frame_poll(win, &frame, inp);
+				produce_issue(frame, inp);
+			}
+
+			struct slot *done_slot = produce_consume();
+			buf = done_slot->txt;
+			*((struct txt_share*)share_buf) = done_slot->share;
+			STAT_END(update);
+
+			// Update thread is idle until the next issue
+			STAT_BEG(convert);
+			if (buf->count > rchar->cap) {
+				rchar_grow(buf->cap);
+				rchar_buf = rchar->mapped + slot * rchar->frame_size;
+			}
+
+			dirty = retain_update(rchar_buf + rchar->tail, slot, mode);
+			retain_hi = retain.hi;
+
+			frame_poll(win, &frame, inp);
+			produce_issue(frame, inp);
+
+			// Converted while the next frame is being updated
+			txt_update(rchar_buf, buf, mode);
+			++produce.consumed;
+			STAT_END(convert);
+		} else
+#endif
+		{
+			STAT_BEG(update);
+			frame_poll(win, &frame, inp);
+			buf = txt;
+			if (cfg.zero_copy) { // Written in place
+				buf->quads = rchar_buf;
+				buf->cap = rchar->cap;
+			}
+
+			*((struct txt_share*)share_buf) = txtquad_update(frame, buf);
+			assert(buf->count <= buf->cap);
+			STAT_END(update);
+
+			STAT_BEG(convert);
+			if (buf->count > rchar->cap) rchar_grow(buf->cap);
+			rchar_buf = rchar->mapped + slot * rchar->frame_size;
+
+			if (!cfg.zero_copy) {
+				txt_update(rchar_buf, buf, mode);
+			}
+
+			dirty = retain_update(rchar_buf + rchar->tail, slot, mode);
+			retain_hi = retain.hi;
+			STAT_END(convert);
+		}
 
-			frame.i_last = frame.i;
-			frame.acc = 0;
+		STAT_ADD(upload, buf->count * rchar->stride);
+		STAT_ADD(upload, (dirty.hi - dirty.lo) * rchar->stride);
+
+		struct indirect *args = vol.indirect.mapped
+			+ slot * vol.indirect.frame_size;
+		u32 counts[2] = { buf->count, retain_hi };
+
+		for (size_t k = 0; k < 2; ++k) {
+			args->draw[k] = (VkDrawIndirectCommand) {
+				.vertexCount = 4, // Quad
+				.instanceCount = cfg.cull ? 0 : counts[k],
+				.firstVertex = 0,
+				.firstInstance = 0,
+			};
+
+			// Survivors are counted on the device
+			args->cull[k] = (VkDispatchIndirectCommand) {
+				.x = (counts[k] + CULL_GROUP - 1) / CULL_GROUP,
+				.y = 1,
+				.z = 1,
+			};
+
+			args->count[k] = counts[k];
 		}
-#endif
-		glfwPollEvents();
-#ifdef INP_KEYS
-		inp_update(win);
-#endif
-		void *share_buf = share.mapped + img_i * share.frame_size;
-		*((struct txt_share*)share_buf) = txtquad_update(frame, &txt);
-		assert(txt.count <= MAX_QUAD);
 
-		void *rchar_buf = rchar.mapped + img_i * rchar.frame_size;
-		txt_update((struct raw_char*)rchar_buf);
+		// Scaled frames only write the image when upscaling
+		VkPipelineStageFlags wait_stage = vol.scaled ?
+			  VK_PIPELINE_STAGE_TRANSFER_BIT
+			: VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+		// Staged quads are copied ahead of the draw
+		int staged = !!rchar->local.buf;
+		VkCommandBuffer cmds[2] = {
+			app.stage.cmd[slot],
+			(*vol.cmd)[
+				(scale.step * sync.frame_n + slot)
+					* vol.swap->img_count
+				+ img_i
+			],
+		};
+
+		if (staged) {
+			record_stage(
+				cmds[0],
+				*rchar,
+				slot,
+				buf->count,
+				dirty,
+				app.stage.full[slot]
+			);
+
+			app.stage.full[slot] = 0;
+		}
 
 		VkSubmitInfo submit_info = {
 		STYPE(SUBMIT_INFO)
-			.waitSemaphoreCount = 0,
-			.pWaitSemaphores = NULL,
-			.pWaitDstStageMask = NULL,
-			.commandBufferCount = 1,
-			.pCommandBuffers = *vol.cmd + img_i,
-			.signalSemaphoreCount = 1,
+			.waitSemaphoreCount = win ? 1 : 0,
+			.pWaitSemaphores = sync.acquire + slot,
+			.pWaitDstStageMask = &wait_stage,
+			.commandBufferCount = 1 + staged,
+			.pCommandBuffers = cmds + !staged,
+			.signalSemaphoreCount = win ? 1 : 0,
 			.pSignalSemaphores = sync.sem + img_i,
 			.pNext = NULL,
 		};
 
-		VkFence fences[2] = { sync.acquire, sync.submit[img_i] };
-		vkWaitForFences(dev.log, 2, fences, VK_TRUE, UINT64_MAX);
-		vkResetFences(dev.log, 2, fences);
+		// Only once a submit is certain to follow
+		STAT_BEG(submit);
+		vkResetFences(dev.log, 1, sync.submit + slot);
 
-		/* TODO: assuming coherent memory
-		err = vkFlushMappedMemoryRanges(dev.log, 1, &range[img_i]);
-		if (err != VK_SUCCESS) {
-			panic_msg("unable to flush mapped memory");
+		/* Flush host writes for non-coherent memory */
+
+		VkMappedMemoryRange ranges[4];
+		u32 range_count = 0;
+		VkDeviceSize atom = dev.props.limits.nonCoherentAtomSize;
+		u64 rchar_off = slot * rchar->frame_size;
+
+		range_count += ak_buf_range(
+			rchar->gpu,
+			atom,
+			rchar_off,
+			buf->count * rchar->stride,
+			ranges + range_count
+		);
+
+		range_count += ak_buf_range(
+			rchar->gpu,
+			atom,
+			rchar_off + rchar->tail + dirty.lo * rchar->stride,
+			(dirty.hi - dirty.lo) * rchar->stride,
+			ranges + range_count
+		);
+
+		range_count += ak_buf_range(
+			share.gpu,
+			atom,
+			slot * share.frame_size,
+			share.stride,
+			ranges + range_count
+		);
+
+		range_count += ak_buf_range(
+			vol.indirect.gpu,
+			atom,
+			slot * vol.indirect.frame_size,
+			sizeof(struct indirect),
+			ranges + range_count
+		);
+
+		if (range_count) {
+			err = vkFlushMappedMemoryRanges(dev.log, range_count, ranges);
+			if (err != VK_SUCCESS) {
+				panic_msg("unable to flush mapped memory");
+			}
 		}
-		*/
 
 		err = vkQueueSubmit(
 			dev.q,
 			1,
 			&submit_info,
-			sync.submit[img_i]
+			sync.submit[slot]
 		);
 
 		if (err != VK_SUCCESS) {
 			panic_msg("unable to submit queue");
 		}
 
+		STAT_END(submit);
+		slot = (slot + 1) % sync.frame_n;
+		++submitted;
+
+		u64 now = now_ns();
+		float dt = (now - stats_prev) * 1e-9;
+		stats_push(dt, buf->count + retain_hi);
+		stats_prev = now;
+
+		// Not the interval, which includes vsync and pacing;
+		// the slower of the host and device work bounds the frame
+		u64 cpu = now - work_beg;
+		scale_update((cpu > gpu ? cpu : gpu) * 1e-9);
+
+		if (now - stats_refresh >= 1000000000ull) {
+			frame.stats = txtquad_frame_stats();
+			stats_refresh = now;
+		}
+
+		if (!win) continue; // Nothing to present
+
 		VkPresentInfoKHR present_info = {
 		STYPE(PRESENT_INFO_KHR)
 			.waitSemaphoreCount = 1,
@@ -2103,15 +5532,28 @@ static void run(
 			.pNext = NULL,
 		};
 
+		STAT_BEG(present);
 		err = vkQueuePresentKHR(dev.q, &present_info);
+		STAT_END(present);
+
 		switch (err) {
 		case VK_SUCCESS:
 			continue;
 		case VK_ERROR_OUT_OF_DATE_KHR:
 		case VK_SUBOPTIMAL_KHR:
 			printf("Swapchain unsuitable for presentation\n");
-			vkDeviceWaitIdle(dev.log);
-			done = reswap(win, surf, dev, graphics, desc, pool, vol);
+			done = reswap(
+				win,
+				surf,
+				dev,
+				graphics,
+				desc,
+				pool,
+				submitted,
+				vol
+			);
+
+			sync = *vol.sync; // Render semaphores may be reallocated
 			frame.size = vol.swap->extent;
 			continue;
 		default:
@@ -2126,20 +5568,39 @@ static void run(
 	}
 
 	vkDeviceWaitIdle(dev.log);
+	if (cfg.stats_csv) stats_dump(cfg.stats_csv);
 }
 
 static void app_free()
 {
-	vkDestroyFence(app.dev.log, app.sync.acquire, NULL);
-	for (size_t i = 0; i < SWAP_IMG_COUNT; ++i) {
+	for (size_t i = 0; i < app.sync.frame_n; ++i) {
+		vkDestroySemaphore(app.dev.log, app.sync.acquire[i], NULL);
 		vkDestroyFence(app.dev.log, app.sync.submit[i], NULL);
-		vkDestroySemaphore(app.dev.log, app.sync.sem[i], NULL);
 	}
 
+	for (size_t i = 0; i < app.sync.img_n; ++i)
+		vkDestroySemaphore(app.dev.log, app.sync.sem[i], NULL);
+
+	free(app.sync.acquire);
 	free(app.sync.submit);
 	free(app.sync.sem);
 
-	swap_free(app.dev.log, app.swap, app.pipe, app.frame, app.pool, app.cmd);
+	if (app.query.ts) vkDestroyQueryPool(app.dev.log, app.query.ts, NULL);
+	if (app.query.pipe) vkDestroyQueryPool(app.dev.log, app.query.pipe, NULL);
+
+	retire_collect(app.dev.log, app.pool, app.sync.frame_n, 0, 1);
+	swap_free(
+		app.dev.log,
+		app.swap,
+		app.frame,
+		app.pool,
+		app.cmd,
+		app.sync.frame_n
+	);
+
+	targets_free(app.dev.log, app.swap);
+	vkDestroyPipelineLayout(app.dev.log, app.pipe.layout, NULL);
+	vkDestroyPipeline(app.dev.log, app.pipe.line, NULL);
 	vkDestroyCommandPool(app.dev.log, app.pool, NULL);
 
 	vkDestroyRenderPass(app.dev.log, app.graphics.pass, NULL);
@@ -2163,27 +5624,47 @@ static void app_free()
 	free(app.desc.sets);
 	vkDestroyDescriptorPool(app.dev.log, app.desc.pool, NULL);
 
+	if (app.cull.line) {
+		vkDestroyPipeline(app.dev.log, app.cull.line, NULL);
+		vkDestroyPipelineLayout(app.dev.log, app.cull.layout, NULL);
+		ak_shader_free(app.dev.log, app.cull.comp);
+		ak_buf_free(app.dev.log, app.list.gpu);
+	}
+
+	ak_buf_free(app.dev.log, app.indirect.gpu);
 	ak_buf_free(app.dev.log, app.rchar.gpu);
+	ak_buf_free(app.dev.log, app.rchar.local);
+	if (app.stage.pool) {
+		vkDestroyCommandPool(app.dev.log, app.stage.pool, NULL);
+	}
+
 	ak_buf_free(app.dev.log, app.share.gpu);
 
 	// Font
 	ak_img_free(app.dev.log, app.font.tex);
 	vkDestroySampler(app.dev.log, app.font.sampler, NULL);
+	ak_buf_free(app.dev.log, app.font.metrics);
 
+	upload_free();
+	vkDestroyPipelineCache(app.dev.log, app.cache, NULL);
+	ak_arena_free();
 	vkDestroyDevice(app.dev.log, NULL);
 	free(app.dev.devices);
 
-	vkDestroySurfaceKHR(app.inst, app.surf, NULL);
+	if (app.surf) vkDestroySurfaceKHR(app.inst, app.surf, NULL);
 	vkDestroyInstance(app.inst, NULL);
 
-	glfwDestroyWindow(app.win);
-	glfwTerminate();
+	if (app.win) {
+		glfwDestroyWindow(app.win);
+		glfwTerminate();
+	}
 
 	printf("Cleanup complete\n");
 }
 
 void txtquad_init(struct txt_cfg cfg)
 {
+	u64 t_init = now_ns();
 	struct extent zero;
 	memset(&zero, 0, sizeof(struct extent));
 
@@ -2196,10 +5677,19 @@ void txtquad_init(struct txt_cfg cfg)
 	case MODE_BORDERLESS:
 		cfg.win_size = zero;
 		break;
+	case MODE_HEADLESS:
+		if (!cfg.win_size.w || !cfg.win_size.h) {
+			cfg.win_size = (struct extent) { HEADLESS_W, HEADLESS_H };
+		}
+		break;
 	default:
 		panic();
 	}
 
+	int headless = cfg.mode == MODE_HEADLESS;
+	int scaled = cfg.frame_budget > 0.f;
+	scale.budget = scaled ? cfg.frame_budget : 0.f;
+
 	int cursor;
 	switch (cfg.cursor) {
 	case CURSOR_SCREEN:
@@ -2212,6 +5702,36 @@ void txtquad_init(struct txt_cfg cfg)
 		panic();
 	}
 
+	size_t stride;
+	switch (cfg.quads) {
+	case QUADS_FULL:
+		stride = cfg.zero_copy ?
+			sizeof(struct txt_quad) : sizeof(struct raw_char);
+		break;
+	case QUADS_PACKED:
+		if (cfg.zero_copy) {
+			panic_msg("zero-copy mode requires QUADS_FULL");
+		}
+
+		stride = sizeof(struct raw_char_packed);
+		break;
+	default:
+		panic();
+	}
+
+	if (cfg.threaded && cfg.zero_copy) {
+		panic_msg("zero-copy mode is incompatible with threaded update");
+	}
+
+	size_t quad_cap = cfg.quad_cap ?: QUAD_CAP;
+	if (!cfg.threaded) {
+		txt = calloc(1, sizeof(struct txt_buf));
+		assert(txt);
+
+		// Mapped per frame in zero-copy mode
+		if (!cfg.zero_copy) txt_grow(txt, quad_cap);
+	}
+
 	const char *app_name = cfg.app_name ?: ENG_NAME;
 	const char *asset_path = cfg.asset_path ?: ASSET_PATH_DEFAULT;
 
@@ -2222,49 +5742,161 @@ void txtquad_init(struct txt_cfg cfg)
 	strncpy(root_path, asset_path, len + 1);
 	filename = root_path + len;
 
-	app.win = mk_win(app_name, cfg.mode, &cfg.win_size, cfg.resizable, cursor);
-	app.inst = mk_inst(app_name);
-	app.surf = mk_surf(app.win, app.inst);
-	app.dev = mk_dev(app.inst, app.surf);
-	app.swap = mk_swap(cfg.win_size, zero, app.dev, app.win, app.surf);
-	app.pool = mk_pool(app.dev);
-	app.font = load_font(app.dev, app.pool);
+	if (headless) {
+		app.win = NULL;
+		app.inst = mk_inst(app_name, 1);
+		app.surf = VK_NULL_HANDLE;
+		app.dev = mk_dev(app.inst, app.surf, cfg.msaa ?: 4);
+		scaled = scale_check(app.dev, scaled);
+		app.swap = mk_offscreen(cfg.win_size, app.dev, scaled);
+	} else {
+		app.win = mk_win(
+			app_name,
+			cfg.mode,
+			&cfg.win_size,
+			cfg.resizable,
+			cursor
+		);
+
+		app.inst = mk_inst(app_name, 0);
+		app.surf = mk_surf(app.win, app.inst);
+		app.dev = mk_dev(app.inst, app.surf, cfg.msaa ?: 4);
+		scaled = scale_check(app.dev, scaled);
+		app.swap = mk_swap(
+			cfg.win_size,
+			zero,
+			app.dev,
+			app.win,
+			app.surf,
+			cfg.present,
+			cfg.swap_images,
+			scaled,
+			NULL
+		);
+	}
+
+	app.pool = mk_pool(app.dev, app.dev.q_ind, 0);
+
+	int cache_warm;
+	app.cache = mk_cache(app.dev, &cache_warm);
+	mk_upload(app.dev);
+	app.font = load_font(app.dev, cfg.sdf);
+
+	u32 frames = cfg.frames ?: FRAMES_IN_FLIGHT;
+	if (frames > MAX_FRAMES_IN_FLIGHT) {
+		panic_msg("too many frames in flight");
+	}
+
+	printf("Using %u frame(s) in flight\n", frames);
+
+	prep_share(app.dev, frames, &app.share);
+	prep_rchar(
+		app.dev,
+		stride,
+		quad_cap,
+		cfg.retained,
+		frames,
+		cfg.device_local,
+		&app.rchar
+	);
+
+	if (app.rchar.local.buf) app.stage = mk_stage(app.dev, frames);
+
+	mk_retain(cfg.retained, frames);
+
+	// Frames are offset by rchar.align from a base that ak_alloc() keeps
+	// AK_MAP_ALIGN-aligned; fold the base in regardless
+	conv = conv_select(
+		app.rchar.align | ((uintptr_t)app.rchar.mapped % AK_MAP_ALIGN)
+	);
+	printf("Using %s quad conversion kernel\n", conv.name);
+#ifdef TXT_DEBUG
+	conv_check(conv);
+#endif
+	mk_work(cfg.workers);
+	mk_produce(cfg.threaded, quad_cap);
 
-	prep_share(app.dev, &app.share);
-	prep_rchar(app.dev, &app.rchar);
-	app.desc = mk_desc_sets(app.dev.log);
+	prep_indirect(app.dev, frames, &app.indirect);
+	app.desc = mk_desc_sets(app.dev.log, frames, cfg.retained, cfg.cull);
 
 	mk_bindings(
 		app.dev.log,
 		app.desc,
 		app.font,
 		app.share,
-		app.rchar
+		app.rchar,
+		cfg.retained,
+		frames
+	);
+
+	if (cfg.cull) {
+		prep_list(app.dev, quad_cap, cfg.retained, frames, &app.list);
+		bind_cull(
+			app.dev.log,
+			app.desc,
+			app.list,
+			app.indirect,
+			cfg.retained,
+			frames
+		);
+
+		app.cull = mk_cull(
+			app.dev.log,
+			app.cache,
+			app.desc,
+			cfg.quads == QUADS_PACKED,
+			cfg.zero_copy
+		);
+	}
+
+	app.graphics = mk_graphics(
+		app.dev,
+		app.swap,
+		cfg.quads == QUADS_PACKED,
+		cfg.zero_copy,
+		cfg.cull,
+		cfg.frag == FRAG_COVERAGE,
+		cfg.sdf,
+		scaled,
+		headless || scaled ? // Scaled frames are blitted from
+			  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+			: VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 	);
 
-	app.graphics = mk_graphics(app.dev, app.swap);
 	app.pipe = mk_pipe(
 		app.dev.log,
-		app.swap.extent,
+		app.cache,
 		app.desc,
 		app.graphics.template
 	);
 
 	app.frame = mk_fbuffers(app.dev.log, app.swap, app.graphics.pass);
+	app.cfg = cfg;
 	app.clear_col = cfg.clear_col;
+	app.query = mk_query(app.dev, frames, cfg.pipeline_stats, scaled);
 	app.cmd = record_graphics(
 		app.dev.log,
 		app.swap,
 		app.desc.sets,
 		app.graphics,
 		app.pipe,
+		app.cull,
 		app.frame,
+		app.indirect,
+		!!cfg.retained,
+		frames,
+		app.query,
 		app.pool,
 		app.clear_col
 	);
 
-	app.sync = mk_sync(app.dev.log);
-	printf("Init success\n");
+	app.sync = mk_sync(app.dev.log, frames, app.swap.img_count);
+	ak_arena_report();
+	printf(
+		"Init success (%.1fms, %s start)\n",
+		(now_ns() - t_init) * 1e-6,
+		cache_warm ? "warm" : "cold"
+	);
 }
 
 void txtquad_start()
@@ -2273,7 +5905,8 @@ void txtquad_start()
 	printf(
 		"Text memory usage: %.2f MB\n",
 		// Note: does not include mapped memory
-		(float)sizeof(struct txt_buf) / (1000 * 1000)
+		(float)(txt ? txt->cap * sizeof(struct txt_quad) : 0)
+			/ (1000 * 1000)
 	);
 #endif
 	run(
@@ -2285,17 +5918,34 @@ void txtquad_start()
 		app.pool,
 		app.sync,
 		app.share,
-		app.rchar,
+		&app.rchar,
+		app.cfg,
 		(struct reswap_data) {
 			.swap = &app.swap,
+			.sync = &app.sync,
 			.pipe = &app.pipe,
+			.cull = app.cull,
+			.cache = app.cache,
 			.frame = &app.frame,
 			.cmd = &app.cmd,
+			.indirect = app.indirect,
+			.retained = !!app.cfg.retained,
+			.frames = app.sync.frame_n,
+			.query = app.query,
+			.present = app.cfg.present,
+			.img_req = app.cfg.swap_images,
+			.scaled = !!app.swap.scene.view,
 			.clear_col = app.clear_col,
 		}
 	);
 
+	cache_write(app.dev, app.cache); // Before the asset path is freed
 	free(root_path);
+	if (txt && !app.cfg.zero_copy) free(txt->quads);
+	free(txt);
+	produce_free();
+	retain_free();
+	work_free();
 	app_free();
 	printf("Exit success\n");
 }
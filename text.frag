@@ -1,4 +1,6 @@
 #version 450
+#include "config.h"
+#define FONT_OFF (FONT_WIDTH / CHAR_WIDTH)
 
 /* Example txtquad fragment shader */
 
@@ -18,12 +20,65 @@ layout (set = 1, binding = 0) uniform Share {
 layout (set = 0, binding = 0) uniform texture2D img;
 layout (set = 0, binding = 1) uniform sampler unf;
 
+/* The atlas has no gutters, so filtered taps are kept half a texel
+ * (of the coarser level sampled) inside the glyph's cell
+ */
+float glyph(vec2 uv, vec2 st)
+{
+	// uv is (st + off) / FONT_OFF; off is the cell's corner
+	vec2 cell = round(uv * FONT_OFF - st) / FONT_OFF;
+	float lod = ceil(textureQueryLod(sampler2D(img, unf), uv).x);
+	float inset = .5 * exp2(lod) / textureSize(sampler2D(img, unf), 0).x;
+
+	vec2 clamped = clamp(uv, cell + inset, cell + 1. / FONT_OFF - inset);
+	return textureGrad(sampler2D(img, unf), clamped, dFdx(uv), dFdy(uv)).r;
+}
+
+#if defined(COVERAGE) || defined(SDF)
+// Fraction of the pixel where d >= 0, over a one-pixel ramp
+float cover(float d)
+{
+	return clamp(d / max(fwidth(d), 1e-6) + .5, 0, 1);
+}
+#endif
+
+#ifdef SDF
+/* Distance-field variant; the glyph edge is antialiased analytically,
+ * so it stays crisp at any scale without multisampling
+ */
+void main()
+{
+	float pad = cover(min(min(st.x, st.y), 1 - max(st.x, st.y))); // Padding
+	float d = glyph(uv, st) - .5; // Positive inside
+
+	float wipe = cover(2 * abs(st.y - .5) - (1 - col.a)); // e.g. basic wipe
+	float alpha = cover(d) * pad * wipe;
+#ifndef COVERAGE
+	if (0 == alpha) discard; // Blended; keep the depth buffer clear
+#endif
+	final = vec4(col.rgb, alpha);
+}
+#elif defined(COVERAGE)
+/* Discard-free variant for alpha-to-coverage, so that early fragment tests
+ * stay enabled; shaded once per pixel, and alpha is never written
+ */
+void main()
+{
+	float pad = cover(min(min(st.x, st.y), 1 - max(st.x, st.y))); // Padding
+	float b = glyph(uv, st);
+
+	float wipe = cover(2 * abs(st.y - .5) - (1 - col.a)); // e.g. basic wipe
+	final = vec4(b * col.rgb, float(b > 0) * pad * wipe);
+}
+#else
 void main()
 {
+	// Sampled first; mip selection needs derivatives from the whole quad
+	float b = glyph(uv, st);
 	if (min(st.x, st.y) < 0 || max(st.x, st.y) > 1) discard; // Padding
-	float b = texture(sampler2D(img, unf), uv).r;
 	if (0 == b) discard;
 
 	if ((1 - col.a) > 2 * abs(st.y - .5)) discard; // e.g. basic wipe effect
 	final = vec4(b * col.rgb, 1);
 }
+#endif
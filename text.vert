@@ -1,18 +1,12 @@
 #version 450
 #include "config.h"
 #define SCALE (float(CHAR_WIDTH) / FONT_WIDTH)
+#define FONT_OFF (FONT_WIDTH / CHAR_WIDTH)
 
-#define VERT_MIN (0.f - PADDING)
-#define VERT_MAX (1.f + PADDING)
-#define   SQ_MIN (MIN_BIAS - PADDING)
-#define   SQ_MAX (MAX_BIAS + PADDING)
+#define SQ_MIN (MIN_BIAS - PADDING)
+#define SQ_MAX (MAX_BIAS + PADDING)
 
-struct Char {
-	mat4 model;
-	vec4 col;
-	vec2 off;
-	vec2 fx;
-};
+#include "char.glsl"
 
 layout (set = 1, binding = 0) uniform Share {
 	mat4 vp;
@@ -20,19 +14,15 @@ layout (set = 1, binding = 0) uniform Share {
 	float time;
 } share;
 
-layout (set = 2, binding = 0) readonly buffer Data { Char chars[MAX_QUAD]; } data;
+layout (set = 2, binding = 0) readonly buffer Data { Char chars[]; } data;
+#ifdef CULL
+layout (set = 2, binding = 1) readonly buffer List { uint idx[]; } list;
+#endif
 
 #ifdef PLATFORM_COMPAT_VBO
-	layout (location = 0) in vec2 vert;
+	layout (location = 0) in vec2 vert; // Unused; corners come from sq
 	layout (location = 1) in vec2 sq;
 #else
-const vec4 vert[4] = {
-	  vec4(VERT_MIN, VERT_MAX, 0, 1)
-	, vec4(VERT_MAX, VERT_MAX, 0, 1)
-	, vec4(VERT_MIN, VERT_MIN, 0, 1)
-	, vec4(VERT_MAX, VERT_MIN, 0, 1)
-};
-
 const vec2 sq[4] = {
 	  vec2(SQ_MIN, SQ_MIN)
 	, vec2(SQ_MAX, SQ_MIN)
@@ -50,24 +40,47 @@ layout (location = 5) out vec3 nor;
 
 void main()
 {
+#ifdef CULL
+	Char c = data.chars[list.idx[gl_InstanceIndex]]; // Visible only
+#else
 	Char c = data.chars[gl_InstanceIndex];
+#endif
 
-#ifdef PLATFORM_COMPAT_VBO
-	st = sq;
+	uint value = char_value(c);
+
+#ifdef PACKED
+	vec2 off = vec2(value % FONT_OFF, value / FONT_OFF);
+	mat4 model = char_model(c);
+
+	col = unpackUnorm4x8(c.col);
+	fx = unpackHalf2x16(c.fx);
+#elif defined(DIRECT)
+	vec2 off = vec2(value % FONT_OFF, value / FONT_OFF);
+	mat4 model = char_model(c);
+
+	col = c.col;
+	fx = c.fx;
 #else
-	st = sq[gl_VertexIndex];
-#endif
+	vec2 off = c.off;
+	mat4 model = char_model(c);
 
-	uv = SCALE * (st + c.off);
 	col = c.col;
 	fx = c.fx;
+#endif
 
 #ifdef PLATFORM_COMPAT_VBO
-	vec4 world = c.model * vec4(vert, 0, 1);
+	vec2 t = step(.5, sq);
 #else
-	vec4 world = c.model * vert[gl_VertexIndex];
+	vec2 t = step(.5, sq[gl_VertexIndex]);
 #endif
+
+	// Trimmed to the glyph's bounds, keeping the bias inset
+	vec2 s = glyph_corner(value, t);
+	st = s + mix(vec2(MIN_BIAS), vec2(-MIN_BIAS), t);
+	uv = SCALE * (st + off);
+
+	vec4 world = model * vec4(s.x, 1 - s.y, 0, 1);
 	gl_Position = share.vp * world;
 	pos = world.xyz;
-	nor = normalize((c.model * vec4(0, 0, -1, 0)).xyz);
+	nor = normalize((model * vec4(0, 0, -1, 0)).xyz);
 }
@@ -20,14 +20,58 @@ struct txt_cfg {
 		  MODE_BORDERLESS
 		, MODE_FULLSCREEN // Note: unsupported aspect ratios will panic
 		, MODE_WINDOWED
+		, MODE_HEADLESS // Offscreen; no window, surface, or swapchain
 	} mode;
-	struct extent win_size; // Ignored for MODE_BORDERLESS
+	struct extent win_size; // Ignored for MODE_BORDERLESS;
+	                        // optional for MODE_HEADLESS
 	int resizable;
 	v3 clear_col;
 	enum {
 		  CURSOR_SCREEN // Always bounded by the screen extent
 		, CURSOR_INF    // Unbounded, but locked to the window
 	} cursor;
+	enum {
+		  QUADS_FULL   // Full model matrix per quad (96 bytes)
+		, QUADS_PACKED // Position, half rotation + scale (32 bytes);
+		               // assumes each model matrix is a uniform-scale TRS
+	} quads;
+	int zero_copy; // Write quads straight into mapped GPU memory;
+	               // requires QUADS_FULL (see txtquad_update())
+	int device_local; // Keep quads in device-local memory; written in place
+	                  // on ReBAR or UMA, else copied from a staging ring
+	int workers; // Quad conversion threads; zero => one per spare core,
+	             // negative => convert on the render thread only
+	u32 quad_cap; // Initial txt_buf capacity; zero => QUAD_CAP (see config.h)
+	u32 retained; // Capacity of the retained quad pool (see txtquad_quad_new())
+	int threaded; // Run txtquad_update() on its own thread, one frame ahead
+	              // of submission; incompatible with zero_copy
+	int cull; // Frustum-cull quads in a compute pre-pass;
+	          // quads at equal depth may be drawn out of order
+	enum {
+		  FRAG_DISCARD  // Shaded per sample; disables early depth testing
+		, FRAG_COVERAGE // Alpha-to-coverage, shaded per pixel; keeps early
+		                // depth testing, at the cost of texel edge quality
+	} frag;
+	int sdf; // Render from a distance field generated at load;
+	         // antialiased in the shader, so it holds up without msaa
+	u32 msaa; // Samples per pixel, clamped to device support; zero => 4
+	u32 frames; // In flight, independent of the swapchain image count;
+	            // zero => FRAMES_IN_FLIGHT (see config.h)
+	enum {
+		  PRESENT_FIFO         // Vsync
+		, PRESENT_FIFO_RELAXED // Vsync, tears when late
+		, PRESENT_MAILBOX      // Falls back to FIFO
+		, PRESENT_IMMEDIATE    // Uncapped; falls back to MAILBOX, then FIFO
+	} present;
+	u32 swap_images; // Clamped to the surface limits; zero => SWAP_IMG_COUNT
+	u32 fps_max; // Sleep between frames to stay under; zero => uncapped
+	float frame_budget; // Seconds of host or device work, whichever is
+	                    // longer; lowers the render scale to stay under,
+	                    // zero => always full resolution (see config.h)
+	u64 frame_count; // Exit after this many frames; zero => until closed
+	                 // or stopped (see txtquad_stop())
+	const char *stats_csv; // Per-frame samples are written here on exit
+	int pipeline_stats; // Query shader invocations (requires TXT_STATS)
 };
 
 // Zero is an acceptable default for all fields
@@ -35,12 +79,51 @@ struct txt_cfg {
 
 /* Per-frame data */
 
+struct txt_dist { // Over the last STATS_FRAMES frames
+	float p50;
+	float p95;
+	float p99;
+	float max;
+};
+
+struct txt_frame_stats {
+	struct txt_dist dt; // Unclamped CPU frame time, in seconds
+	struct txt_dist quads; // Drawn per frame, including retained quads
+	size_t n; // Frames sampled
+};
+
+#ifdef TXT_STATS
+struct txt_stats { // Render loop phases, in nanoseconds
+	u64 pace;    // Sleeping for txt_cfg.fps_max
+	u64 wait;    // On the frame-in-flight fence
+	u64 acquire;
+	u64 update;  // txtquad_update(), or waiting on it in threaded mode
+	u64 convert; // Quad conversion and retained uploads
+	u64 submit;  // Including mapped memory flushes
+	u64 present;
+	u64 upload;  // Bytes written to the quad buffer
+
+	/* GPU queries, from the last frame to use the same slot in flight;
+	 * invocation counts require txt_cfg.pipeline_stats
+	 */
+
+	u64 gpu; // Command buffer execution, from timestamps
+	u64 vert_invoc;
+	u64 clip_invoc;
+	u64 frag_invoc;
+};
+#endif
+
 struct txt_frame {
 	size_t i;
 	float t;
 	float t_prev;
 	float dt;
 	struct extent size;
+	struct txt_frame_stats stats; // Refreshed once per second
+#ifdef TXT_STATS
+	struct txt_stats phases; // Of the previous frame
+#endif
 #ifdef TXT_DEBUG
 	float acc;
 	size_t i_last;
@@ -65,16 +148,21 @@ struct txt_share {
 
 struct txt_buf {
 	size_t count;
-	struct txt_quad {
-		u8  value;
+	size_t cap; // See txtquad_reserve()
+	struct txt_quad { // Laid out as read by the GPU in zero-copy mode
 		m4  model;
 		v4  color;
 		v2 _extra;
-	} quads[MAX_QUAD];
+		u8  value;
+		u8 _pad[7];
+	} *quads;
 };
 
 /*
  * User callback; must be implemented by consumer (you)
+ *
+ * In zero-copy mode, the txt_buf lives in write-combined GPU memory:
+ * write each quad once, and avoid reading back from it.
  */
 __attribute__((weak))
 struct txt_share txtquad_update(struct txt_frame, struct txt_buf*);
@@ -84,5 +172,29 @@ struct txt_share txtquad_update(struct txt_frame, struct txt_buf*);
  */
 void txtquad_init(const struct txt_cfg);
 void txtquad_start();
+void txtquad_stop(); // Exit the render loop after the current frame
+
+/*
+ * Grows the txt_buf to hold at least n quads, keeping those already written;
+ * call from txtquad_update() before writing past txt_buf.cap.
+ * GPU buffers follow on upload, stalling the device for a frame.
+ */
+void txtquad_reserve(struct txt_buf*, size_t n);
+
+/*
+ * Computed on demand; not safe to call from txtquad_update()
+ * in threaded mode (read txt_frame.stats instead)
+ */
+struct txt_frame_stats txtquad_frame_stats();
+
+/*
+ * Retained quads persist across frames and are drawn after the txt_buf;
+ * only the quads edited since an image was last rendered are re-uploaded.
+ * Handles are valid until freed. Requires txt_cfg.retained > 0.
+ */
+typedef u32 txt_handle;
+txt_handle txtquad_quad_new(); // Zeroed (hidden) until edited
+struct txt_quad *txtquad_quad_edit(txt_handle); // Marks the quad for upload
+void txtquad_quad_free(txt_handle);
 
 #endif
@@ -58,15 +58,11 @@ static void ak_print_props_mem(VkMemoryPropertyFlags prop_mask, const char *form
 	}
 }
 
-static u32 ak_mem_type_idx(
+static int ak_mem_type_find(
 	VkPhysicalDeviceMemoryProperties props_mem,
 	u32 type_mask,
 	VkMemoryPropertyFlags prop_mask
 ) {
-	printf("\t| ");
-	ak_print_props_mem(prop_mask, "%s ");
-	printf("\n");
-
 	for (u32 i = 0; i < props_mem.memoryTypeCount; ++i) {
 		int compat = type_mask & (1 << i);
 		if (!compat) continue;
@@ -76,23 +72,436 @@ static u32 ak_mem_type_idx(
 		compat = prop_mask == (flags & prop_mask);
 		if (!compat) continue;
 
-		printf("\t| using memory type %u\n", i);
 		return i;
 	}
 
-	panic_msg("no compatible memory type found");
 	return -1;
 }
 
+// Falls back to the required properties if the preferred ones are missing
+static u32 ak_mem_type_idx_pref(
+	VkPhysicalDeviceMemoryProperties props_mem,
+	u32 type_mask,
+	VkMemoryPropertyFlags prop_mask,
+	VkMemoryPropertyFlags pref_mask
+) {
+	printf("\t| ");
+	ak_print_props_mem(prop_mask, "%s ");
+	if (pref_mask) {
+		printf("(preferred: ");
+		ak_print_props_mem(pref_mask, "%s ");
+		printf(")");
+	}
+	printf("\n");
+
+	int i = ak_mem_type_find(props_mem, type_mask, prop_mask | pref_mask);
+	if (i < 0) i = ak_mem_type_find(props_mem, type_mask, prop_mask);
+	if (i < 0) panic_msg("no compatible memory type found");
+
+	printf("\t| using memory type %d\n", i);
+	return i;
+}
+
+static u32 ak_mem_type_idx(
+	VkPhysicalDeviceMemoryProperties props_mem,
+	u32 type_mask,
+	VkMemoryPropertyFlags prop_mask
+) {
+	return ak_mem_type_idx_pref(props_mem, type_mask, prop_mask, 0);
+}
+
 static inline u64 ak_align_up(u64 size, u64 align)
 {
 	--align;
 	return (size + align) & ~align;
 }
 
+static int ak_inst_ext_find(const char *name)
+{
+	u32 count;
+	vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+	VkExtensionProperties props[count];
+	vkEnumerateInstanceExtensionProperties(NULL, &count, props);
+
+	for (u32 i = 0; i < count; ++i) {
+		if (!strcmp(props[i].extensionName, name)) return 1;
+	}
+
+	return 0;
+}
+
+static int ak_dev_ext_find(VkPhysicalDevice dev, const char *name)
+{
+	u32 count;
+	vkEnumerateDeviceExtensionProperties(dev, NULL, &count, NULL);
+	VkExtensionProperties props[count];
+	vkEnumerateDeviceExtensionProperties(dev, NULL, &count, props);
+
+	for (u32 i = 0; i < count; ++i) {
+		if (!strcmp(props[i].extensionName, name)) return 1;
+	}
+
+	return 0;
+}
+
+/* Memory arena;
+ * resources are carved out of large blocks per memory type, first fit
+ * from each block's sorted free list. Buffers and images never share
+ * a block, which sidesteps bufferImageGranularity. Host-visible blocks
+ * stay mapped for their whole lifetime
+ */
+
+#define AK_BLOCK_SIZE (64ull << 20) // Clamped to an eighth of the heap
+#define AK_BLOCK_MAX 64
+#define AK_SPAN_MAX 128 // Free spans per block
+#define AK_MAP_ALIGN 64 // Of host-visible sub-allocations
+
+struct ak_alloc {
+	VkDeviceMemory mem; // Shared with the rest of the block
+	VkDeviceSize off;
+	VkDeviceSize size; // Reserved; atom-aligned if flushes are needed
+	u32 block;
+	void *mapped; // At off; null unless host-visible
+};
+
+static struct ak_arena {
+	VkPhysicalDevice hard;
+	VkDevice dev;
+	VkPhysicalDeviceMemoryProperties props_mem;
+	VkDeviceSize atom; // nonCoherentAtomSize
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR props2; // Null w/o budget
+	struct ak_block {
+		VkDeviceMemory mem; // Null if the slot is unused
+		VkDeviceSize size;
+		u32 type;
+		int linear; // Buffers, as opposed to images
+		int solo; // Sized to one resource; freed along with it
+		void *mapped;
+		struct ak_span {
+			VkDeviceSize off;
+			VkDeviceSize size;
+		} free[AK_SPAN_MAX];
+		u32 free_n;
+		u32 live;
+	} blocks[AK_BLOCK_MAX];
+	u32 block_n;
+	VkDeviceSize used[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize reserved[VK_MAX_MEMORY_HEAPS]; // In blocks
+} ak_arena;
+
+// Pass a null props2 if VK_EXT_memory_budget is not enabled
+static void ak_arena_init(
+	VkPhysicalDevice hard,
+	VkDevice dev,
+	VkPhysicalDeviceMemoryProperties props_mem,
+	VkDeviceSize atom,
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR props2
+) {
+	memset(&ak_arena, 0, sizeof(ak_arena));
+	ak_arena.hard = hard;
+	ak_arena.dev = dev;
+	ak_arena.props_mem = props_mem;
+	ak_arena.atom = atom;
+	ak_arena.props2 = props2;
+}
+
+// Returns zero for the budget if unknown
+static void ak_heap_budget(u32 heap, VkDeviceSize *budget, VkDeviceSize *usage)
+{
+	*budget = 0;
+	*usage = ak_arena.reserved[heap];
+	if (!ak_arena.props2) return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = {
+	STYPE(PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT)
+		.pNext = NULL,
+	};
+
+	VkPhysicalDeviceMemoryProperties2KHR props = {
+	STYPE(PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR)
+		.pNext = &budget_props,
+	};
+
+	ak_arena.props2(ak_arena.hard, &props);
+	*budget = budget_props.heapBudget[heap];
+	*usage = budget_props.heapUsage[heap]; // Includes other processes
+}
+
+static u32 ak_block_mk(u32 type, int linear, VkDeviceSize min_size)
+{
+	VkMemoryType t = ak_arena.props_mem.memoryTypes[type];
+	VkDeviceSize heap_size = ak_arena.props_mem.memoryHeaps[t.heapIndex].size;
+
+	VkDeviceSize size = AK_BLOCK_SIZE < heap_size / 8 ?
+		AK_BLOCK_SIZE : heap_size / 8;
+
+	VkDeviceSize budget, usage;
+	ak_heap_budget(t.heapIndex, &budget, &usage);
+	if (!budget) budget = heap_size;
+	VkDeviceSize avail = budget > usage ? budget - usage : 0;
+
+	// Shrink to the request under pressure
+	if (size < min_size || size > avail) size = min_size;
+	if (size > avail) {
+		printf("Warning: memory heap %u is over budget\n", t.heapIndex);
+	}
+
+	VkMemoryAllocateInfo alloc_info = {
+	STYPE(MEMORY_ALLOCATE_INFO)
+		.allocationSize = size,
+		.memoryTypeIndex = type,
+		.pNext = NULL,
+	};
+
+	VkDeviceMemory mem;
+	VkResult err = vkAllocateMemory(ak_arena.dev, &alloc_info, NULL, &mem);
+	if (err != VK_SUCCESS) {
+		panic_msg("unable to allocate memory block");
+	}
+
+	void *mapped = NULL;
+	if (t.propertyFlags & AK_MEM_PROP(HOST_VISIBLE)) {
+		err = vkMapMemory(ak_arena.dev, mem, 0, VK_WHOLE_SIZE, 0, &mapped);
+		if (err != VK_SUCCESS) {
+			panic_msg("unable to map device memory to host");
+		}
+	}
+
+	u32 b = 0;
+	while (b < ak_arena.block_n && ak_arena.blocks[b].mem) ++b;
+	if (b == AK_BLOCK_MAX) panic_msg("too many memory blocks");
+	if (b == ak_arena.block_n) ++ak_arena.block_n;
+
+	ak_arena.blocks[b] = (struct ak_block) {
+		.mem = mem,
+		.size = size,
+		.type = type,
+		.linear = linear,
+		.solo = size == min_size,
+		.mapped = mapped,
+		.free = { { 0, size } },
+		.free_n = 1,
+		.live = 0,
+	};
+
+	ak_arena.reserved[t.heapIndex] += size;
+	printf(
+		"\t| new %.1fMB block on heap %u\n",
+		(float)size / (1024 * 1024),
+		t.heapIndex
+	);
+
+	return b;
+}
+
+// Returns zero if no span fits
+static int ak_block_take(
+	struct ak_block *block,
+	VkDeviceSize size,
+	VkDeviceSize align,
+	VkDeviceSize *out
+) {
+	for (u32 i = 0; i < block->free_n; ++i) {
+		struct ak_span span = block->free[i];
+		VkDeviceSize beg = ak_align_up(span.off, align);
+		VkDeviceSize end = beg + size;
+		VkDeviceSize span_end = span.off + span.size;
+		if (end > span_end) continue;
+
+		int left = beg > span.off, right = end < span_end;
+		if (left && right) {
+			if (block->free_n == AK_SPAN_MAX) continue; // Can't split
+			memmove(
+				block->free + i + 2,
+				block->free + i + 1,
+				(block->free_n - i - 1) * sizeof(struct ak_span)
+			);
+
+			block->free[i].size = beg - span.off;
+			block->free[i + 1] = (struct ak_span) { end, span_end - end };
+			++block->free_n;
+		} else if (left) {
+			block->free[i].size = beg - span.off;
+		} else if (right) {
+			block->free[i] = (struct ak_span) { end, span_end - end };
+		} else {
+			memmove(
+				block->free + i,
+				block->free + i + 1,
+				(block->free_n - i - 1) * sizeof(struct ak_span)
+			);
+
+			--block->free_n;
+		}
+
+		*out = beg;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Coalesces with its neighbours
+static void ak_block_give(
+	struct ak_block *block,
+	VkDeviceSize off,
+	VkDeviceSize size
+) {
+	u32 i = 0;
+	while (i < block->free_n && block->free[i].off < off) ++i;
+
+	struct ak_span *prev = i ? block->free + i - 1 : NULL;
+	struct ak_span *next = i < block->free_n ? block->free + i : NULL;
+	int merge_prev = prev && prev->off + prev->size == off;
+	int merge_next = next && off + size == next->off;
+
+	if (merge_prev && merge_next) {
+		prev->size += size + next->size;
+		memmove(
+			block->free + i,
+			block->free + i + 1,
+			(block->free_n - i - 1) * sizeof(struct ak_span)
+		);
+
+		--block->free_n;
+	} else if (merge_prev) {
+		prev->size += size;
+	} else if (merge_next) {
+		next->off = off;
+		next->size += size;
+	} else {
+		if (block->free_n == AK_SPAN_MAX) {
+			panic_msg("memory block free list is full");
+		}
+
+		memmove(
+			block->free + i + 1,
+			block->free + i,
+			(block->free_n - i) * sizeof(struct ak_span)
+		);
+
+		block->free[i] = (struct ak_span) { off, size };
+		++block->free_n;
+	}
+}
+
+static struct ak_alloc ak_alloc(VkMemoryRequirements req, u32 type, int linear)
+{
+	assert(ak_arena.dev);
+
+	VkMemoryPropertyFlags flags
+		= ak_arena.props_mem.memoryTypes[type].propertyFlags;
+	u32 heap = ak_arena.props_mem.memoryTypes[type].heapIndex;
+
+	// Keep flushed ranges from straddling a neighbour's atom
+	int flush = (flags & AK_MEM_PROP(HOST_VISIBLE))
+		&& !(flags & AK_MEM_PROP(HOST_COHERENT));
+
+	VkDeviceSize align = req.alignment;
+	VkDeviceSize size = req.size;
+
+	// Mapped blocks start at least 64-byte aligned (minMemoryMapAlignment);
+	// keep each mapped sub-allocation on a cache line as well
+	if (flags & AK_MEM_PROP(HOST_VISIBLE))
+		align = align > AK_MAP_ALIGN ? align : AK_MAP_ALIGN;
+
+	if (flush) {
+		align = align > ak_arena.atom ? align : ak_arena.atom;
+		size = ak_align_up(size, ak_arena.atom);
+	}
+
+	VkDeviceSize off;
+	u32 b = 0;
+	for (; b < ak_arena.block_n; ++b) {
+		struct ak_block *block = ak_arena.blocks + b;
+		if (!block->mem || block->solo) continue;
+		if (block->type != type || block->linear != linear) continue;
+		if (ak_block_take(block, size, align, &off)) break;
+	}
+
+	if (b == ak_arena.block_n) {
+		b = ak_block_mk(type, linear, size);
+		int ok = ak_block_take(ak_arena.blocks + b, size, align, &off);
+		assert(ok);
+	}
+
+	struct ak_block *block = ak_arena.blocks + b;
+	++block->live;
+	ak_arena.used[heap] += size;
+
+	return (struct ak_alloc) {
+		.mem = block->mem,
+		.off = off,
+		.size = size,
+		.block = b,
+		.mapped = block->mapped ? (char*)block->mapped + off : NULL,
+	};
+}
+
+static void ak_release(struct ak_alloc alloc)
+{
+	if (!alloc.mem) return; // Null resource
+
+	struct ak_block *block = ak_arena.blocks + alloc.block;
+	u32 heap = ak_arena.props_mem.memoryTypes[block->type].heapIndex;
+
+	ak_block_give(block, alloc.off, alloc.size);
+	ak_arena.used[heap] -= alloc.size;
+	if (--block->live || !block->solo) return;
+
+	vkFreeMemory(ak_arena.dev, block->mem, NULL); // Also unmaps
+	ak_arena.reserved[heap] -= block->size;
+	block->mem = VK_NULL_HANDLE;
+}
+
+static void ak_arena_report()
+{
+	for (u32 i = 0; i < ak_arena.props_mem.memoryHeapCount; ++i) {
+		if (!ak_arena.reserved[i]) continue;
+
+		VkDeviceSize budget, usage;
+		ak_heap_budget(i, &budget, &usage);
+
+		printf(
+			"Heap %u: %.1fMB used of %.1fMB in blocks",
+			i,
+			(float)ak_arena.used[i] / (1024 * 1024),
+			(float)ak_arena.reserved[i] / (1024 * 1024)
+		);
+
+		if (budget) printf(
+			" (%.1fMB of %.1fMB budget)",
+			(float)usage / (1024 * 1024),
+			(float)budget / (1024 * 1024)
+		);
+
+		printf("\n");
+	}
+}
+
+static void ak_arena_free()
+{
+	for (u32 b = 0; b < ak_arena.block_n; ++b) {
+		struct ak_block *block = ak_arena.blocks + b;
+		if (!block->mem) continue;
+		if (block->live) {
+			printf(
+				"Warning: freeing memory block %u "
+				"with %u live allocation(s)\n",
+				b,
+				block->live
+			);
+		}
+
+		vkFreeMemory(ak_arena.dev, block->mem, NULL);
+	}
+
+	memset(&ak_arena, 0, sizeof(ak_arena));
+}
+
 struct ak_img {
 	VkImage img;
-	VkDeviceMemory mem;
+	struct ak_alloc alloc;
 	VkMemoryRequirements req;
 	VkImageView view;
 };
@@ -115,10 +524,26 @@ struct ak_img {
 	); \
 }
 
-static void ak_img_mk(
+#define AK_IMG_MK_MIPS(DEV, MEM, HANDLE, W, H, L, FORMAT, USAGE, ASPECT, OUT) \
+{ \
+	AK_IMG_HEAD(HANDLE); \
+	ak_img_mk_mips( \
+		DEV, \
+		MEM, \
+		W, H, L, \
+		0, \
+		FORMAT, \
+		USAGE, \
+		VK_IMAGE_ASPECT_ ## ASPECT ## _BIT, \
+		OUT \
+	); \
+}
+
+static void ak_img_mk_mips(
 	VkDevice dev,
 	VkPhysicalDeviceMemoryProperties mem_info,
 	u32 width, u32 height,
+	u32 levels,
 	VkSampleCountFlagBits sample_n,
 	VkFormat format,
 	VkImageUsageFlags usage,
@@ -132,7 +557,7 @@ static void ak_img_mk(
 		.imageType = VK_IMAGE_TYPE_2D,
 		.format = format,
 		.extent = { width, height, 1 },
-		.mipLevels = 1,
+		.mipLevels = levels,
 		.arrayLayers = 1,
 		.samples = sample_n ?: VK_SAMPLE_COUNT_1_BIT,
 		.tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -155,25 +580,15 @@ static void ak_img_mk(
 	VkMemoryRequirements req;
 	vkGetImageMemoryRequirements(dev, img, &req);
 
-	VkMemoryAllocateInfo alloc_info = {
-	STYPE(MEMORY_ALLOCATE_INFO)
-		.allocationSize = req.size,
-		.memoryTypeIndex = ak_mem_type_idx(
-			mem_info,
-			req.memoryTypeBits,
-			// All images are currently host-inaccessible
-			AK_MEM_PROP(DEVICE_LOCAL)
-		),
-		.pNext = NULL,
-	};
-
-	VkDeviceMemory mem;
-	err = vkAllocateMemory(dev, &alloc_info, NULL, &mem);
-	if (err != VK_SUCCESS) {
-		panic_msg("unable to allocate memory for image");
-	}
+	u32 type_idx = ak_mem_type_idx(
+		mem_info,
+		req.memoryTypeBits,
+		// All images are currently host-inaccessible
+		AK_MEM_PROP(DEVICE_LOCAL)
+	);
 
-	vkBindImageMemory(dev, img, mem, 0);
+	struct ak_alloc alloc = ak_alloc(req, type_idx, 0);
+	err = vkBindImageMemory(dev, img, alloc.mem, alloc.off);
 	if (err != VK_SUCCESS) {
 		panic_msg("unable to bind image memory");
 	}
@@ -192,7 +607,7 @@ static void ak_img_mk(
 		.subresourceRange = {
 			.aspectMask = aspect,
 			.baseMipLevel = 0,
-			.levelCount = 1,
+			.levelCount = levels,
 			.baseArrayLayer = 0,
 			.layerCount = 1,
 		},
@@ -206,23 +621,47 @@ static void ak_img_mk(
 	}
 
 	out->img = img;
-	out->mem = mem;
+	out->alloc = alloc;
 	out->req = req;
 	out->view = view;
 }
 
+static void ak_img_mk(
+	VkDevice dev,
+	VkPhysicalDeviceMemoryProperties mem_info,
+	u32 width, u32 height,
+	VkSampleCountFlagBits sample_n,
+	VkFormat format,
+	VkImageUsageFlags usage,
+	VkImageAspectFlags aspect,
+	struct ak_img *const out
+) {
+	ak_img_mk_mips(
+		dev,
+		mem_info,
+		width, height,
+		1,
+		sample_n,
+		format,
+		usage,
+		aspect,
+		out
+	);
+}
+
 static void ak_img_free(VkDevice dev, struct ak_img ak)
 {
 	vkDestroyImage(dev, ak.img, NULL);
 	vkDestroyImageView(dev, ak.view, NULL);
-	vkFreeMemory(dev, ak.mem, NULL);
+	ak_release(ak.alloc);
 }
 
 struct ak_buf {
 	VkBuffer buf;
-	VkDeviceMemory mem;
+	struct ak_alloc alloc;
 	VkDeviceSize size;
 	VkMemoryRequirements alloc_info;
+	VkMemoryPropertyFlags props; // Of the memory type actually used
 };
 
 #define AK_BUF_HEAD(HANDLE, SZ) \
@@ -235,12 +674,13 @@ struct ak_buf {
 	ak_buf_mk(DEV, MEM, SZ, AK_BUF_USAGE(USAGE), PROPS, OUT); \
 }
 
-static void ak_buf_mk(
+static void ak_buf_mk_pref(
 	VkDevice dev,
 	VkPhysicalDeviceMemoryProperties mem_info,
 	VkDeviceSize size,
 	VkBufferUsageFlags usage,
 	VkMemoryPropertyFlags props_mem,
+	VkMemoryPropertyFlags props_pref,
 	struct ak_buf *out
 ) {
 	VkResult err;
@@ -271,24 +711,15 @@ static void ak_buf_mk(
 		printf("\t| aligned up to %" PRIu64 "\n", req.size);
 	}
 
-	VkMemoryAllocateInfo alloc_info = {
-	STYPE(MEMORY_ALLOCATE_INFO)
-		.allocationSize = req.size,
-		.memoryTypeIndex = ak_mem_type_idx(
-			mem_info,
-			req.memoryTypeBits,
-			props_mem
-		),
-		.pNext = NULL,
-	};
-
-	VkDeviceMemory mem;
-	err = vkAllocateMemory(dev, &alloc_info, NULL, &mem);
-	if (err != VK_SUCCESS) {
-		panic_msg("unable to allocate memory for buffer");
-	}
+	u32 type_idx = ak_mem_type_idx_pref(
+		mem_info,
+		req.memoryTypeBits,
+		props_mem,
+		props_pref
+	);
 
-	err = vkBindBufferMemory(dev, buf, mem, 0);
+	struct ak_alloc alloc = ak_alloc(req, type_idx, 1);
+	err = vkBindBufferMemory(dev, buf, alloc.mem, alloc.off);
 	if (err != VK_SUCCESS) {
 		panic_msg("unable to bind buffer memory");
 	}
@@ -296,9 +727,21 @@ static void ak_buf_mk(
 	printf("\t. allocated\n");
 
 	out->buf = buf;
-	out->mem = mem;
+	out->alloc = alloc;
 	out->size = size;
 	out->alloc_info = req;
+	out->props = mem_info.memoryTypes[type_idx].propertyFlags;
+}
+
+static void ak_buf_mk(
+	VkDevice dev,
+	VkPhysicalDeviceMemoryProperties mem_info,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags props_mem,
+	struct ak_buf *out
+) {
+	ak_buf_mk_pref(dev, mem_info, size, usage, props_mem, 0, out);
 }
 
 #define AK_BUF_MK_AND_MAP(DEV, MEM, HANDLE, SZ, USAGE, OUT, SRC) \
@@ -315,30 +758,54 @@ static void ak_buf_mk_and_map(
 	struct ak_buf *out,
 	void **src
 ) {
-	ak_buf_mk(
+	// Non host-coherent memory must be flushed by the caller
+	ak_buf_mk_pref(
 		dev,
 		props_mem,
 		size,
 		usage,
-		// TODO: support uncached and/or non host-coherent heaps
-		AK_MEM_PROP(HOST_VISIBLE) | AK_MEM_PROP(HOST_COHERENT),
+		AK_MEM_PROP(HOST_VISIBLE),
+		AK_MEM_PROP(HOST_COHERENT),
 		out
 	);
 
-	VkResult err;
-	err = vkMapMemory(dev, out->mem, 0, VK_WHOLE_SIZE, 0, src);
-	if (err != VK_SUCCESS) {
-		panic_msg("unable to map device memory to host");
-	}
+	// Blocks are mapped whole when created
+	*src = out->alloc.mapped;
+	assert(*src);
 
 	printf("\t. backed\n");
 }
 
+// Note: returns zero when no flush is required
+static int ak_buf_range(
+	struct ak_buf ak,
+	VkDeviceSize atom, // nonCoherentAtomSize
+	VkDeviceSize off,
+	VkDeviceSize size,
+	VkMappedMemoryRange *out
+) {
+	if (!size || ak.props & AK_MEM_PROP(HOST_COHERENT)) return 0;
+
+	// The allocation itself is atom-aligned (see ak_alloc())
+	VkDeviceSize beg = off / atom * atom;
+	VkDeviceSize end = (off + size + atom - 1) / atom * atom;
+	if (end > ak.alloc.size) end = ak.alloc.size;
+
+	*out = (VkMappedMemoryRange) {
+	STYPE(MAPPED_MEMORY_RANGE)
+		.memory = ak.alloc.mem,
+		.offset = ak.alloc.off + beg,
+		.size = end - beg,
+		.pNext = NULL,
+	};
+
+	return 1;
+}
+
 static void ak_buf_free(VkDevice dev, struct ak_buf ak)
 {
 	vkDestroyBuffer(dev, ak.buf, NULL);
-	vkUnmapMemory(dev, ak.mem); // TODO: check if mapped
-	vkFreeMemory(dev, ak.mem, NULL);
+	ak_release(ak.alloc); // Mappings live with the block
 }
 
 #define AK_MK_SET_LAYOUT(DEV, HANDLE, BINDINGS, COUNT, OUT) \